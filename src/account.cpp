@@ -0,0 +1,81 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QProcessEnvironment>
+#include <QSettings>
+
+#include "account.h"
+
+/*!
+ * Read account credentials from the FITBIT_USERNAME, FITBIT_PASSWORD, POLAR_USERNAME and
+ * POLAR_PASSWORD environment variables (and the optional FITBIT_USER_ID).
+ */
+Account Account::fromEnvironment()
+{
+    Account account;
+    account.name = QStringLiteral("environment");
+    #define FETCH_ENV(var, name) \
+        account.var = QProcessEnvironment::systemEnvironment().value(QLatin1String(#name))
+    FETCH_ENV(fitbitUsername, FITBIT_USERNAME);
+    FETCH_ENV(fitbitPassword, FITBIT_PASSWORD);
+    FETCH_ENV(fitbitUserId, FITBIT_USER_ID);
+    FETCH_ENV(polarUsername, POLAR_USERNAME);
+    FETCH_ENV(polarPassword, POLAR_PASSWORD);
+    #undef FETCH_ENV
+    return account;
+}
+
+/*!
+ * Read account credentials from the \a fileName ini file, falling back to \a defaults for any
+ * credentials not present in the file.
+ */
+Account Account::fromFile(const QString &fileName, const Account &defaults)
+{
+    Account account = defaults;
+    account.name = fileName;
+    QSettings settings(fileName, QSettings::IniFormat);
+    qDebug() << fileName << settings.allKeys();
+    #define FETCH_SETTING(var, name) \
+        if (settings.contains(QLatin1String(#name))) \
+            account.var = settings.value(QLatin1String(#name)).toString()
+    FETCH_SETTING(fitbitUsername, Fitbit/username);
+    FETCH_SETTING(fitbitPassword, Fitbit/password);
+    FETCH_SETTING(fitbitUserId, Fitbit/userId);
+    FETCH_SETTING(polarUsername, Polar/username);
+    FETCH_SETTING(polarPassword, Polar/password);
+    #undef FETCH_SETTING
+    return account;
+}
+
+/*!
+ * Returns the names of any required settings that are missing from this account.
+ */
+QStringList Account::missingSettings() const
+{
+    QStringList missing;
+    #define REQUIRE_SETTING(var, name) \
+        if (var.isEmpty()) missing.append(QStringLiteral(#name))
+    REQUIRE_SETTING(fitbitUsername, Fitbit/username);
+    REQUIRE_SETTING(fitbitPassword, Fitbit/password);
+    REQUIRE_SETTING(polarUsername, Polar/username);
+    REQUIRE_SETTING(polarPassword, Polar/password);
+    #undef REQUIRE_SETTING
+    return missing;
+}
@@ -0,0 +1,40 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ACCOUNT_H
+#define ACCOUNT_H
+
+#include <QString>
+#include <QStringList>
+
+struct Account {
+    QString name; // Identifies the account in logs and summaries; eg the credentials file name.
+    QString fitbitUsername;
+    QString fitbitPassword;
+    QString fitbitUserId; // Optional; matches the account to Fitbit notifications' owner IDs.
+    QString polarUsername;
+    QString polarPassword;
+
+    static Account fromEnvironment();
+    static Account fromFile(const QString &fileName, const Account &defaults = Account());
+
+    QStringList missingSettings() const;
+};
+
+#endif // ACCOUNT_H
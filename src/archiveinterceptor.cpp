@@ -0,0 +1,65 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+
+#include "archiveinterceptor.h"
+
+ArchiveInterceptor::ArchiveInterceptor(const WebArchive::Mode mode, QObject * parent)
+    : QWebEngineUrlRequestInterceptor(parent), mode(mode)
+{
+
+}
+
+ArchiveInterceptor::~ArchiveInterceptor()
+{
+
+}
+
+void ArchiveInterceptor::interceptRequest(QWebEngineUrlRequestInfo &info)
+{
+    const QUrl url = info.requestUrl();
+    if (url.scheme() == QString::fromLatin1(ARCHIVE_SCHEME)) {
+        return; // Already being served from (or via) the archive.
+    }
+
+    if (url.scheme() != QStringLiteral("https")) {
+        if (mode == WebArchive::Mode::Replay) {
+            qDebug() << "Blocking unarchivable request" << url.toString();
+            info.block(true);
+        }
+        return;
+    }
+
+    // Note, Qt WebEngine does not expose request bodies to scheme handlers, so only requests whose
+    // bodies (if any) are carried in their URLs by the archive's page script can be proxied (and
+    // thus recorded). Others go straight to the network when recording, and since they were never
+    // recorded, are blocked when replaying (keeping replays offline).
+    if ((info.requestMethod() != "GET") && (!WebArchive::hasRequestBody(url))) {
+        if (mode == WebArchive::Mode::Replay) {
+            qDebug() << "Blocking unarchived" << info.requestMethod() << url.toString();
+            info.block(true);
+        } else {
+            qDebug() << "Not recording" << info.requestMethod() << url.toString();
+        }
+        return;
+    }
+
+    info.redirect(WebArchive::archiveUrl(url));
+}
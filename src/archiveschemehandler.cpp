@@ -0,0 +1,374 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QBuffer>
+#include <QDebug>
+#include <QNetworkAccessManager>
+#include <QNetworkCookie>
+#include <QNetworkCookieJar>
+#include <QNetworkReply>
+#include <QTimer>
+#include <QWebEngineCookieStore>
+#include <QWebEngineProfile>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
+#include <QWebEngineUrlRequestJob>
+
+#include "archiveschemehandler.h"
+#include "webarchive.h"
+
+#define REQUEST_BODY_SCRIPT_NAME QStringLiteral("archiveRequestBodies")
+
+/*!
+ * Construct a handler that serves \a profile's archive scheme requests from the network (while
+ * recording them into \a archive), or from \a archive alone, depending on the archive's mode.
+ *
+ * Qt WebEngine does not expose request bodies to interceptors or scheme handlers, so a script is
+ * also added to the \a profile that carries the bodies of its pages' fetch, XHR and (URL encoded)
+ * form requests to the archive, in their URLs' query items (see WebArchive::takeRequestBody()).
+ */
+ArchiveSchemeHandler::ArchiveSchemeHandler(WebArchive * archive, QWebEngineProfile * profile,
+                                           QObject * parent)
+    : QWebEngineUrlSchemeHandler(parent), archive(archive), profile(profile),
+      network(Q_NULLPTR), latency(0)
+{
+    if (archive->mode() == WebArchive::Mode::Record) {
+        // Requests that bypass the archive (eg uploads of binary blobs) are made by the browser, so
+        // keep our network access manager's cookies in sync with the profile's, and vice versa.
+        network = new QNetworkAccessManager(this);
+        connect(profile->cookieStore(), &QWebEngineCookieStore::cookieAdded,
+                this, [this](const QNetworkCookie &cookie) {
+            network->cookieJar()->insertCookie(cookie);
+        });
+        connect(profile->cookieStore(), &QWebEngineCookieStore::cookieRemoved,
+                this, [this](const QNetworkCookie &cookie) {
+            network->cookieJar()->deleteCookie(cookie);
+        });
+        profile->cookieStore()->loadAllCookies();
+    }
+
+    const QWebEngineScript existing = profile->scripts()->findScript(REQUEST_BODY_SCRIPT_NAME);
+    if (!existing.isNull()) {
+        profile->scripts()->remove(existing);
+    }
+    profile->scripts()->insert(requestBodyScript());
+}
+
+ArchiveSchemeHandler::~ArchiveSchemeHandler()
+{
+
+}
+
+/*!
+ * Delay each replayed response by \a msecs, to simulate network latency.
+ */
+void ArchiveSchemeHandler::setLatency(const int msecs)
+{
+    latency = msecs;
+}
+
+void ArchiveSchemeHandler::requestStarted(QWebEngineUrlRequestJob * job)
+{
+    if (archive->mode() == WebArchive::Mode::Record) {
+        record(job);
+    } else {
+        replay(job);
+    }
+}
+
+// Protected Methods
+
+/*!
+ * Fetches \a job's request from the network, on behalf of the browser, and archives the response.
+ * The browser's own request headers are forwarded (along with the profile's cookies, user agent
+ * and languages), and redirects are passed back to the browser to follow, so that the sites behave
+ * as they would without recording.
+ */
+void ArchiveSchemeHandler::record(QWebEngineUrlRequestJob * job)
+{
+    QByteArray method = job->requestMethod(), body, contentType;
+    const QUrl url = WebArchive::takeRequestBody(WebArchive::originalUrl(job->requestUrl()),
+                                                 method, body, contentType);
+    QNetworkRequest request(url);
+    request.setAttribute(QNetworkRequest::RedirectPolicyAttribute,
+                         QNetworkRequest::ManualRedirectPolicy);
+    if (profile) {
+        request.setHeader(QNetworkRequest::UserAgentHeader, profile->httpUserAgent());
+        if (!profile->httpAcceptLanguage().isEmpty()) {
+            request.setRawHeader("Accept-Language", profile->httpAcceptLanguage().toLatin1());
+        }
+    }
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    const QMap<QByteArray, QByteArray> headers = job->requestHeaders();
+    for (auto iter = headers.constBegin(); iter != headers.constEnd(); ++iter) {
+        request.setRawHeader(iter.key(), iter.value());
+    }
+#endif
+    if (!contentType.isEmpty()) {
+        request.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+    }
+    QNetworkReply * const reply = network->sendCustomRequest(request, method, body);
+
+    const QPointer<QWebEngineUrlRequestJob> pendingJob(job);
+    connect(reply, &QNetworkReply::finished, this,
+            [this, pendingJob, reply, method, url, body]() {
+        reply->deleteLater();
+        WebArchive::Response response;
+        response.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        response.mimeType = reply->header(QNetworkRequest::ContentTypeHeader)
+            .toString().section(QLatin1Char(';'), 0, 0).trimmed().toLatin1();
+        const QUrl location = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
+        if (location.isValid()) {
+            response.location = url.resolved(location);
+        }
+        response.headers = reply->rawHeaderPairs();
+        response.body = reply->readAll();
+
+        // Only archive actual HTTP responses (even errors), so network failures are not replayed.
+        if (response.status == 0) {
+            qWarning().noquote() << "Failed to fetch" << url.toString() << reply->errorString()
+                                 << "(not recording)";
+            if (pendingJob) {
+                pendingJob->fail(QWebEngineUrlRequestJob::RequestFailed);
+            }
+            return;
+        }
+        archive->store(method, url, body, response);
+        if (pendingJob) { // Else the browser has since cancelled the request.
+            respond(pendingJob, url, response);
+        }
+    });
+}
+
+void ArchiveSchemeHandler::replay(QWebEngineUrlRequestJob * job)
+{
+    QByteArray method = job->requestMethod(), body, contentType;
+    const QUrl url = WebArchive::takeRequestBody(WebArchive::originalUrl(job->requestUrl()),
+                                                 method, body, contentType);
+    WebArchive::Response response;
+    if (!archive->load(method, url, body, response)) {
+        qWarning().noquote() << "No archived response for" << method << url.toString();
+        job->fail(QWebEngineUrlRequestJob::UrlNotFound);
+        return;
+    }
+
+    if (latency <= 0) {
+        respond(job, url, response);
+        return;
+    }
+    const QPointer<QWebEngineUrlRequestJob> pendingJob(job);
+    QTimer::singleShot(latency, this, [this, pendingJob, url, response]() {
+        if (pendingJob) {
+            respond(pendingJob, url, response);
+        }
+    });
+}
+
+/*!
+ * Answers \a job with the (live or archived) \a response to its request for \a url. Any cookies the
+ * response sets are passed on to the browser, and redirects are passed back for the browser to
+ * follow (via the archive, for https locations).
+ *
+ * Note, Qt WebEngine's scheme handlers cannot set a response's status or headers, so other
+ * responses are answered with their body and MIME type alone, or failed if their status is an
+ * error (4xx or 5xx).
+ */
+void ArchiveSchemeHandler::respond(QWebEngineUrlRequestJob * job, const QUrl &url,
+                                   const WebArchive::Response &response)
+{
+    if (profile) {
+        for (const QPair<QByteArray, QByteArray> &header: response.headers) {
+            if (qstricmp(header.first.constData(), "Set-Cookie") == 0) {
+                for (const QNetworkCookie &cookie: QNetworkCookie::parseCookies(header.second)) {
+                    profile->cookieStore()->setCookie(cookie, url);
+                }
+            }
+        }
+    }
+
+    if ((response.status >= 300) && (response.status < 400) && (response.location.isValid())) {
+        job->redirect((response.location.scheme() == QStringLiteral("https"))
+            ? WebArchive::archiveUrl(response.location) : response.location);
+        return;
+    }
+    if (response.status >= 400) {
+        qDebug().noquote() << "Failing" << url.toString() << "with status" << response.status;
+        job->fail(((response.status == 404) || (response.status == 410))
+            ? QWebEngineUrlRequestJob::UrlNotFound : QWebEngineUrlRequestJob::RequestFailed);
+        return;
+    }
+    QBuffer * const buffer = new QBuffer(job);
+    buffer->setData(response.body);
+    job->reply(response.mimeType.isEmpty() ? QByteArrayLiteral("text/html") : response.mimeType,
+               buffer);
+}
+
+/*!
+ * Returns a script that rewrites the URLs of its page's fetch, XHR and form requests with bodies,
+ * to carry those bodies (along with their content types, and for forms, which are submitted as GET
+ * navigations instead, their methods) to the archive. Bodies that can't be read synchronously (eg
+ * blobs, and forms with files) are left as is, and so are not archived.
+ */
+QWebEngineScript ArchiveSchemeHandler::requestBodyScript()
+{
+    // Note, this must run in the main world, so that it wraps the page's own fetch / XHR objects.
+    QWebEngineScript script;
+    script.setName(REQUEST_BODY_SCRIPT_NAME);
+    script.setInjectionPoint(QWebEngineScript::DocumentCreation);
+    script.setWorldId(QWebEngineScript::MainWorld);
+    script.setRunsOnSubFrames(true);
+    script.setSourceCode(QStringLiteral(R"JS(
+        (function () {
+            // Returns body as a (binary) string for btoa(), or undefined if it can't be archived.
+            const binary = function (body) {
+                if ((body === undefined) || (body === null)) {
+                    return '';
+                }
+                if (typeof body === 'string') {
+                    return unescape(encodeURIComponent(body));
+                }
+                if (body instanceof URLSearchParams) {
+                    return body.toString();
+                }
+                if ((body instanceof ArrayBuffer) || (ArrayBuffer.isView(body))) {
+                    const bytes = (body instanceof ArrayBuffer) ? new Uint8Array(body)
+                        : new Uint8Array(body.buffer, body.byteOffset, body.byteLength);
+                    let string = '';
+                    bytes.forEach((byte) => string += String.fromCharCode(byte));
+                    return string;
+                }
+                return undefined;
+            };
+            const defaultType = function (body) {
+                return (typeof body === 'string') ? 'text/plain;charset=UTF-8'
+                    : (body instanceof URLSearchParams)
+                    ? 'application/x-www-form-urlencoded;charset=UTF-8' : '';
+            };
+            // Returns url with the query items that carry the request to the archive, or url
+            // itself if the request can't be archived.
+            const archivable = function (url, method, body, type) {
+                const data = binary(body);
+                const target = new URL(url, document.baseURI);
+                if ((data === undefined) ||
+                    ((target.protocol !== 'https:') && (target.protocol !== '%4:'))) {
+                    return url;
+                }
+                const items = [ '%1=' + encodeURIComponent(btoa(data)) ];
+                if (method) {
+                    items.push('%2=' + encodeURIComponent(method));
+                }
+                if (type) {
+                    items.push('%3=' + encodeURIComponent(type));
+                }
+                target.search = (target.search ? target.search + '&' : '?') + items.join('&');
+                return target.href;
+            };
+            const isBodiless = (method) => /^(GET|HEAD)$/i.test(String(method || 'GET'));
+
+            const fetch = window.fetch;
+            if (fetch) {
+                window.fetch = function (input, init) {
+                    // Request objects' bodies can only be read asynchronously, so are left as is.
+                    if ((input instanceof Request) || (!init) || (isBodiless(init.method))) {
+                        return fetch.apply(this, arguments);
+                    }
+                    const type = new Headers(init.headers).get('Content-Type') ||
+                        defaultType(init.body);
+                    return fetch.call(this, archivable(String(input), null, init.body, type), init);
+                };
+            }
+
+            // Reopening a request resets its headers, so remember them, to set again if need be.
+            const open = XMLHttpRequest.prototype.open;
+            XMLHttpRequest.prototype.open = function () {
+                this.archiveOpen = Array.prototype.slice.call(arguments);
+                this.archiveHeaders = [];
+                return open.apply(this, arguments);
+            };
+            const setRequestHeader = XMLHttpRequest.prototype.setRequestHeader;
+            XMLHttpRequest.prototype.setRequestHeader = function (name, value) {
+                if (this.archiveHeaders) {
+                    this.archiveHeaders.push([ name, value ]);
+                }
+                return setRequestHeader.apply(this, arguments);
+            };
+            const send = XMLHttpRequest.prototype.send;
+            XMLHttpRequest.prototype.send = function (body) {
+                const args = this.archiveOpen;
+                if ((args) && (!isBodiless(args[0]))) {
+                    const header = this.archiveHeaders.filter(
+                        (header) => String(header[0]).toLowerCase() === 'content-type').pop();
+                    const url = archivable(String(args[1]), null, body,
+                                           header ? String(header[1]) : defaultType(body));
+                    if (url !== String(args[1])) {
+                        const headers = this.archiveHeaders;
+                        args[1] = url;
+                        open.apply(this, args);
+                        headers.forEach((header) => setRequestHeader.apply(this, header));
+                    }
+                }
+                return send.apply(this, arguments);
+            };
+
+            // Submits a URL encoded POST form as a GET navigation that carries its body, returning
+            // false if the form is to be submitted as is.
+            const attribute = (submitter, name, fallback) =>
+                ((submitter) && (submitter.hasAttribute(name))) ? submitter[name] : fallback;
+            const submit = function (form, submitter) {
+                const target = attribute(submitter, 'formTarget', form.target);
+                if ((String(attribute(submitter, 'formMethod', form.method)).toUpperCase() !==
+                     'POST') || (attribute(submitter, 'formEnctype', form.enctype) !==
+                     'application/x-www-form-urlencoded') || ((target) && (target !== '_self'))) {
+                    return false;
+                }
+                const data = new FormData(form);
+                if ((submitter) && (submitter.name)) {
+                    data.append(submitter.name, submitter.value);
+                }
+                const params = new URLSearchParams();
+                for (const [name, value] of data) {
+                    if (typeof value !== 'string') {
+                        return false; // A file.
+                    }
+                    params.append(name, value);
+                }
+                const action = attribute(submitter, 'formAction', form.action);
+                const url = archivable(action, 'POST', params, 'application/x-www-form-urlencoded');
+                if (url === action) {
+                    return false;
+                }
+                window.location.assign(url);
+                return true;
+            };
+            window.addEventListener('submit', function (event) {
+                if ((!event.defaultPrevented) && (submit(event.target, event.submitter))) {
+                    event.preventDefault();
+                }
+            });
+            const formSubmit = HTMLFormElement.prototype.submit;
+            HTMLFormElement.prototype.submit = function () {
+                if (!submit(this, null)) {
+                    return formSubmit.apply(this, arguments);
+                }
+            };
+        })();
+    )JS").arg(QString::fromLatin1(ARCHIVE_BODY_ITEM), QString::fromLatin1(ARCHIVE_METHOD_ITEM),
+              QString::fromLatin1(ARCHIVE_TYPE_ITEM), QString::fromLatin1(ARCHIVE_SCHEME)));
+    return script;
+}
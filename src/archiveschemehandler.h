@@ -0,0 +1,61 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef ARCHIVESCHEMEHANDLER_H
+#define ARCHIVESCHEMEHANDLER_H
+
+#include <QPointer>
+#include <QWebEngineUrlSchemeHandler>
+
+#include "webarchive.h"
+
+class QNetworkAccessManager;
+class QWebEngineProfile;
+class QWebEngineScript;
+
+class ArchiveSchemeHandler : public QWebEngineUrlSchemeHandler
+{
+    Q_OBJECT
+
+public:
+    ArchiveSchemeHandler(WebArchive * archive, QWebEngineProfile * profile,
+                         QObject * parent = Q_NULLPTR);
+    ~ArchiveSchemeHandler() override;
+
+    void setLatency(const int msecs);
+
+    void requestStarted(QWebEngineUrlRequestJob * job) override;
+
+protected:
+    void record(QWebEngineUrlRequestJob * job);
+    void replay(QWebEngineUrlRequestJob * job);
+    void respond(QWebEngineUrlRequestJob * job, const QUrl &url,
+                 const WebArchive::Response &response);
+
+    static QWebEngineScript requestBodyScript();
+
+private:
+    WebArchive * archive;
+    QPointer<QWebEngineProfile> profile;
+    QNetworkAccessManager * network;
+    int latency;
+
+};
+
+#endif // ARCHIVESCHEMEHANDLER_H
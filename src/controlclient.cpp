@@ -0,0 +1,148 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "controlclient.h"
+#include "exitcode.h"
+
+/*!
+ * Construct a client that asks the server listening on the \a serverName local socket to sync
+ * \a accounts (or all of the server's accounts, if empty), and waits for the results.
+ */
+ControlClient::ControlClient(const QString &serverName, const QStringList &accounts,
+                             QObject * parent)
+    : QObject(parent), serverName(serverName), accounts(accounts), isFinished(false)
+{
+    connect(&socket, &QLocalSocket::connected, this, [this]() {
+        const QJsonObject request {
+            { QStringLiteral("accounts"), QJsonArray::fromStringList(this->accounts) }
+        };
+        socket.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + '\n');
+    });
+    connect(&socket, &QLocalSocket::readyRead, this, &ControlClient::readReplies);
+    connect(&socket, &QLocalSocket::disconnected, this, [this]() {
+        if (!isFinished) {
+            qCritical().noquote() << "Server disconnected before all results were received";
+            isFinished = true;
+            emit finished(ExitCode::Failure);
+        }
+    });
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    connect(&socket, &QLocalSocket::errorOccurred,
+#else
+    connect(&socket, static_cast<void(QLocalSocket::*)(QLocalSocket::LocalSocketError)>
+            (&QLocalSocket::error),
+#endif
+            this, [this](const QLocalSocket::LocalSocketError error) {
+        if ((!isFinished) && (error != QLocalSocket::PeerClosedError)) {
+            qCritical().noquote() << "Control socket error" << error << socket.errorString();
+            isFinished = true;
+            emit finished(ExitCode::Failure);
+        }
+    });
+}
+
+ControlClient::~ControlClient()
+{
+
+}
+
+/*!
+ * Returns the merged summaries of the accounts' results, with each section prefixed by its account.
+ */
+RunSummary ControlClient::summary() const
+{
+    return runSummary;
+}
+
+// Public Slots
+
+void ControlClient::start()
+{
+    qDebug() << "Requesting sync from" << serverName;
+    socket.connectToServer(serverName);
+}
+
+// Protected Methods
+
+void ControlClient::readReplies()
+{
+    while (socket.canReadLine()) {
+        const QByteArray line = socket.readLine().trimmed();
+        QJsonParseError error;
+        const QJsonObject reply = QJsonDocument::fromJson(line, &error).object();
+        if (error.error != QJsonParseError::NoError) {
+            qWarning().noquote() << "Failed to parse server reply" << line << error.errorString();
+            continue;
+        }
+
+        // The first reply lists the accounts that results will follow for.
+        if (reply.contains(QLatin1String("accounts"))) {
+            for (const QJsonValue &account: reply.value(QLatin1String("accounts")).toArray()) {
+                expected.append(account.toString());
+            }
+            continue;
+        }
+
+        const QString account = reply.value(QLatin1String("account")).toString();
+        if (reply.contains(QLatin1String("status"))) {
+            qInfo().noquote() << "Sync of" << account
+                              << reply.value(QLatin1String("status")).toString();
+            continue;
+        }
+
+        const int exitCode = reply.value(QLatin1String("exitCode")).toInt(ExitCode::Failure);
+        qInfo().noquote() << "Account" << account << "finished with exit code" << exitCode;
+        exitCodes.insert(account, exitCode);
+        if (reply.contains(QLatin1String("error"))) {
+            runSummary.insert(QStringLiteral("%1:run").arg(account), QStringLiteral("error"),
+                              reply.value(QLatin1String("error")).toString());
+        }
+        const QJsonObject sections = reply.value(QLatin1String("summary")).toObject();
+        for (auto iter = sections.constBegin(); iter != sections.constEnd(); ++iter) {
+            runSummary.insert(QStringLiteral("%1:%2").arg(account, iter.key()),
+                              iter.value().toObject().toVariantMap());
+        }
+    }
+
+    // Once all results are in, report the overall result.
+    for (const QString &account: expected) {
+        if (!exitCodes.contains(account)) {
+            return;
+        }
+    }
+    if ((expected.isEmpty()) || (isFinished)) {
+        return;
+    }
+    int exitCode = ExitCode::Success;
+    for (auto iter = exitCodes.constBegin(); iter != exitCodes.constEnd(); ++iter) {
+        if (iter.value() != ExitCode::Success) {
+            exitCode = iter.value();
+        }
+    }
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("accounts"), exitCodes.size());
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("exitCode"), exitCode);
+    isFinished = true;
+    socket.disconnectFromServer();
+    emit finished(exitCode);
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTROLCLIENT_H
+#define CONTROLCLIENT_H
+
+#include <QLocalSocket>
+#include <QMap>
+#include <QObject>
+#include <QStringList>
+
+#include "runsummary.h"
+
+class ControlClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    ControlClient(const QString &serverName, const QStringList &accounts,
+                  QObject * parent = Q_NULLPTR);
+    virtual ~ControlClient();
+
+    RunSummary summary() const;
+
+public slots:
+    void start();
+
+protected:
+    void readReplies();
+
+private:
+    const QString serverName;
+    const QStringList accounts;
+    QLocalSocket socket;
+    QStringList expected;
+    QMap<QString, int> exitCodes;
+    RunSummary runSummary;
+    bool isFinished;
+
+signals:
+    void finished(const int exitCode);
+
+};
+
+#endif // CONTROLCLIENT_H
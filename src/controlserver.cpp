@@ -0,0 +1,262 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+
+#include <algorithm>
+
+#include "controlserver.h"
+#include "exitcode.h"
+
+/*!
+ * Constructs a server that syncs any of \a accounts on request, using \a options.
+ */
+ControlServer::ControlServer(const QList<Account> &accounts, const SyncJob::Options &options,
+                             QObject * parent)
+    : QObject(parent), accounts(accounts), options(options)
+{
+    connect(&server, &QLocalServer::newConnection, this, &ControlServer::onNewConnection);
+}
+
+ControlServer::~ControlServer()
+{
+
+}
+
+/*!
+ * Begin listening for requests on the \a name local socket, accessible to the current user only.
+ * A stale socket (left behind by a crashed server) is replaced, but a live one (another server) is
+ * not.
+ */
+bool ControlServer::listen(const QString &name)
+{
+    // Only let our own user request syncs (and read their summaries, including weights). The option
+    // applies to both listen calls below.
+    server.setSocketOptions(QLocalServer::UserAccessOption);
+    if ((!server.listen(name)) && (server.serverError() == QAbstractSocket::AddressInUseError)) {
+        QLocalSocket probe;
+        probe.connectToServer(name);
+        if (probe.waitForConnected(1000)) {
+            qCritical().noquote() << "Another server is already listening on" << name;
+            return false;
+        }
+        qDebug() << "Removing stale server" << name;
+        QLocalServer::removeServer(name);
+        server.listen(name);
+    }
+    if (!server.isListening()) {
+        qCritical().noquote() << "Failed to listen on" << name << server.errorString();
+        return false;
+    }
+    qInfo().noquote() << "Listening for sync requests on" << server.fullServerName();
+    return true;
+}
+
+// Public Slots
+
+/*!
+ * Sync the \a name account, unless a sync is already in flight. If \a fresh, the Fitbit fetch
+ * cache is bypassed, and a sync already in flight (which may have fetched too soon) is followed by
+ * another.
+ */
+void ControlServer::requestSync(const QString &name, const bool fresh)
+{
+    Account account;
+    if (!findAccount(name, account)) {
+        qWarning().noquote() << "Sync requested for unknown account" << name;
+        return;
+    }
+    if (!startJob(account, fresh)) {
+        qInfo().noquote() << "Sync of" << account.name << "already in flight"
+                          << (fresh ? "(will sync again after)" : "");
+    }
+}
+
+// Protected Methods
+
+/*!
+ * Finds the account named \a name (either its full name, or the name's base file name), returning
+ * \c true if found.
+ */
+bool ControlServer::findAccount(const QString &name, Account &account) const
+{
+    const auto iter = std::find_if(accounts.constBegin(), accounts.constEnd(),
+        [&name](const Account &account) {
+            return ((account.name == name) ||
+                    (QFileInfo(account.name).completeBaseName() == name));
+        });
+    if (iter == accounts.constEnd()) {
+        return false;
+    }
+    account = *iter;
+    return true;
+}
+
+/*!
+ * Handles a sync \a request from \a socket. The request names the accounts to sync (all of them if
+ * none are named), and the reply begins by listing the accounts that results will follow for.
+ */
+void ControlServer::handleRequest(QLocalSocket * socket, const QJsonObject &request)
+{
+    QStringList names;
+    for (const QJsonValue &name: request.value(QLatin1String("accounts")).toArray()) {
+        names.append(name.toString());
+    }
+    QList<Account> requested;
+    QStringList unknown;
+    for (const QString &name: names) {
+        Account account;
+        if (findAccount(name, account)) {
+            requested.append(account);
+        } else {
+            unknown.append(name);
+        }
+    }
+    if (names.isEmpty()) {
+        requested = accounts;
+    }
+
+    QStringList resolved;
+    for (const Account &account: requested) {
+        resolved.append(account.name);
+    }
+    send(socket, {
+        { QStringLiteral("accounts"), QJsonArray::fromStringList(resolved + unknown) },
+    });
+    for (const QString &name: unknown) {
+        qWarning().noquote() << "Sync requested for unknown account" << name;
+        send(socket, {
+            { QStringLiteral("account"), name },
+            { QStringLiteral("exitCode"), ExitCode::Failure },
+            { QStringLiteral("error"), QStringLiteral("Unknown account") },
+        });
+    }
+    for (const Account &account: requested) {
+        join(socket, account);
+    }
+}
+
+/*!
+ * Adds \a socket to the waiters for \a account's result, starting a sync job for the account if
+ * one is not already in flight. Either way, a single job serves all concurrent requests.
+ */
+void ControlServer::join(QLocalSocket * socket, const Account &account)
+{
+    waiters[account.name].append(socket);
+    const bool started = startJob(account, false);
+    send(socket, {
+        { QStringLiteral("account"), account.name },
+        { QStringLiteral("status"),
+          started ? QStringLiteral("started") : QStringLiteral("joined") },
+    });
+    if (!started) {
+        qInfo().noquote() << "Joining in-flight sync of" << account.name;
+    }
+}
+
+void ControlServer::send(QLocalSocket * socket, const QJsonObject &message)
+{
+    socket->write(QJsonDocument(message).toJson(QJsonDocument::Compact) + '\n');
+    socket->flush();
+}
+
+/*!
+ * Starts a sync job for \a account, bypassing the Fitbit fetch cache if \a fresh. Returns \c false
+ * (having started nothing) if a job for the account is already in flight.
+ */
+bool ControlServer::startJob(const Account &account, const bool fresh)
+{
+    if (jobs.contains(account.name)) {
+        if (fresh) {
+            reruns.insert(account.name);
+        }
+        return false;
+    }
+
+    SyncJob::Options jobOptions = options;
+    if (fresh) {
+        jobOptions.fetchDaily = false;
+        jobOptions.fetchTtlSecs = 0;
+        jobOptions.fetchWindowStart = jobOptions.fetchWindowEnd = QTime();
+    }
+    SyncJob * const job = new SyncJob(account, jobOptions, this);
+    jobs.insert(account.name, job);
+    connect(job, &SyncJob::finished, this, [this, job](const int exitCode) {
+        onJobFinished(job, exitCode);
+    });
+    job->start();
+    return true;
+}
+
+// Protected Slots
+
+/*!
+ * Streams \a job's result (its \a exitCode and summary) back to everyone waiting for it.
+ */
+void ControlServer::onJobFinished(SyncJob * job, const int exitCode)
+{
+    const QString name = job->account().name;
+    const RunSummary summary = job->summary();
+    summary.log();
+
+    const QJsonObject result {
+        { QStringLiteral("account"), name },
+        { QStringLiteral("exitCode"), exitCode },
+        { QStringLiteral("summary"), summary.toJson() },
+    };
+    for (const QPointer<QLocalSocket> &socket: waiters.take(name)) {
+        if (socket) {
+            send(socket, result);
+        }
+    }
+
+    // Release this job's web pages (and renderer processes); the engine itself stays warm.
+    jobs.remove(name);
+    job->deleteLater();
+    if (reruns.remove(name)) {
+        startJob(job->account(), true);
+    }
+}
+
+void ControlServer::onNewConnection()
+{
+    while (QLocalSocket * const socket = server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            while (socket->canReadLine()) {
+                const QByteArray line = socket->readLine().trimmed();
+                if (line.isEmpty()) {
+                    continue;
+                }
+                QJsonParseError error;
+                const QJsonObject request = QJsonDocument::fromJson(line, &error).object();
+                if (error.error != QJsonParseError::NoError) {
+                    qWarning().noquote() << "Failed to parse sync request" << line
+                                         << error.errorString();
+                    continue;
+                }
+                handleRequest(socket, request);
+            }
+        });
+        connect(socket, &QLocalSocket::disconnected, socket, &QLocalSocket::deleteLater);
+    }
+}
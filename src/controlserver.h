@@ -0,0 +1,71 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef CONTROLSERVER_H
+#define CONTROLSERVER_H
+
+#include <QJsonObject>
+#include <QList>
+#include <QLocalServer>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+
+#include "account.h"
+#include "syncjob.h"
+
+class QLocalSocket;
+
+class ControlServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    ControlServer(const QList<Account> &accounts, const SyncJob::Options &options,
+                  QObject * parent = Q_NULLPTR);
+    virtual ~ControlServer();
+
+    bool listen(const QString &name);
+
+public slots:
+    void requestSync(const QString &name, const bool fresh = false);
+
+protected:
+    bool findAccount(const QString &name, Account &account) const;
+    void handleRequest(QLocalSocket * socket, const QJsonObject &request);
+    void join(QLocalSocket * socket, const Account &account);
+    static void send(QLocalSocket * socket, const QJsonObject &message);
+    bool startJob(const Account &account, const bool fresh);
+
+protected slots:
+    void onJobFinished(SyncJob * job, const int exitCode);
+    void onNewConnection();
+
+private:
+    QLocalServer server;
+    const QList<Account> accounts;
+    const SyncJob::Options options;
+    QMap<QString, SyncJob *> jobs; // Account name -> in-flight job.
+    QMap<QString, QList<QPointer<QLocalSocket>>> waiters; // Account name -> requesters.
+    QSet<QString> reruns; // Accounts to sync (fresh) again, once their in-flight jobs finish.
+
+};
+
+#endif // CONTROLSERVER_H
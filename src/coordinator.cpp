@@ -0,0 +1,254 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QUuid>
+
+#include "coordinator.h"
+
+/*!
+ * Construct a coordinator that shards \a credentialFiles across (up to) \a workerCount worker
+ * processes. Each worker is this same executable, invoked with \a workerArguments, plus the worker
+ * socket and credential file options for its shard.
+ */
+Coordinator::Coordinator(const QStringList &credentialFiles, const int workerCount,
+                         const QStringList &workerArguments, QObject * parent)
+    : QObject(parent), workerArguments(workerArguments), maxRestarts(2)
+{
+    shards.resize(qBound(1, workerCount, qMax(1, credentialFiles.size())));
+    for (int index = 0; index < credentialFiles.size(); ++index) {
+        shards[index % shards.size()].accounts.append(credentialFiles.at(index));
+    }
+    connect(&server, &QLocalServer::newConnection, this, &Coordinator::onNewConnection);
+}
+
+Coordinator::~Coordinator()
+{
+    for (const Shard &shard: shards) {
+        if ((shard.process) && (shard.process->state() != QProcess::NotRunning)) {
+            shard.process->kill();
+            shard.process->waitForFinished();
+        }
+    }
+}
+
+/*!
+ * Restart each shard's worker at most \a restarts times if it exits without reporting results for
+ * all of its accounts (eg because it crashed).
+ */
+void Coordinator::setMaxRestarts(const int restarts)
+{
+    maxRestarts = restarts;
+}
+
+RunSummary Coordinator::summary() const
+{
+    return runSummary;
+}
+
+// Public Slots
+
+void Coordinator::start()
+{
+    const QString serverName = QStringLiteral("float-%1-%2")
+        .arg(QCoreApplication::applicationPid())
+        .arg(QUuid::createUuid().toString(QUuid::Id128));
+    server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!server.listen(serverName)) {
+        qCritical().noquote() << "Failed to listen on" << serverName << server.errorString();
+        emit finished(EXIT_FAILURE);
+        return;
+    }
+    int accounts = 0;
+    for (const Shard &shard: shards) {
+        accounts += shard.accounts.size();
+    }
+    qInfo().noquote() << "Starting" << shards.size() << "workers for" << accounts << "accounts";
+    for (int shard = 0; shard < shards.size(); ++shard) {
+        startWorker(shard);
+    }
+}
+
+// Protected Methods
+
+void Coordinator::processResult(const QByteArray &line)
+{
+    QJsonParseError error;
+    const QJsonObject result = QJsonDocument::fromJson(line, &error).object();
+    if (error.error != QJsonParseError::NoError) {
+        qWarning().noquote() << "Failed to parse worker result" << line << error.errorString();
+        return;
+    }
+    const QString account = result.value(QStringLiteral("account")).toString();
+    const int exitCode = result.value(QStringLiteral("exitCode")).toInt(EXIT_FAILURE);
+    qInfo().noquote() << "Account" << account << "finished with exit code" << exitCode;
+    exitCodes.insert(account, exitCode);
+    const QJsonObject sections = result.value(QStringLiteral("summary")).toObject();
+    for (auto iter = sections.constBegin(); iter != sections.constEnd(); ++iter) {
+        runSummary.insert(QStringLiteral("%1:%2").arg(account, iter.key()),
+                          iter.value().toObject().toVariantMap());
+    }
+}
+
+void Coordinator::readResults(QLocalSocket * socket)
+{
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) {
+            continue;
+        }
+        // The first line from each worker identifies its process, and thus its shard.
+        if (line.startsWith("{\"pid\"")) {
+            const qint64 pid = QJsonDocument::fromJson(line).object()
+                .value(QStringLiteral("pid")).toVariant().toLongLong();
+            for (Shard &shard: shards) {
+                if ((shard.process) && (shard.process->processId() == pid)) {
+                    shard.socket = socket;
+                }
+            }
+            continue;
+        }
+        processResult(line);
+    }
+}
+
+void Coordinator::startWorker(const int shard)
+{
+    QStringList arguments = workerArguments;
+    arguments << QStringLiteral("--worker") << server.fullServerName();
+    for (const QString &account: shards.at(shard).accounts) {
+        arguments << QStringLiteral("--credentials") << account;
+    }
+
+    QProcess * const process = new QProcess(this);
+    process->setProcessChannelMode(QProcess::ForwardedChannels);
+    connect(process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>
+            (&QProcess::finished), this,
+            [this, shard](const int exitCode, const QProcess::ExitStatus exitStatus) {
+        qDebug() << "Worker for shard" << shard << "exited" << exitCode << exitStatus;
+        updateShard(shard);
+    });
+    connect(process, &QProcess::errorOccurred, this, [this, shard](QProcess::ProcessError error) {
+        if (error == QProcess::FailedToStart) {
+            qWarning() << "Worker for shard" << shard << "failed to start";
+            updateShard(shard);
+        }
+    });
+    shards[shard].process = process;
+    shards[shard].socket = Q_NULLPTR;
+    process->start(QCoreApplication::applicationFilePath(), arguments);
+}
+
+/*!
+ * Check whether \a shard's worker has finished (and disconnected). If so, restart it for any of
+ * its accounts that it didn't report results for, or give up on them if it's been restarted too
+ * many times already.
+ */
+void Coordinator::updateShard(const int shard)
+{
+    // Make sure any sockets not yet matched to a worker have been read, in case one of them
+    // belongs to this shard's worker, and has results waiting.
+    if (!shards.at(shard).socket) {
+        for (QLocalSocket * const socket: server.findChildren<QLocalSocket *>()) {
+            if (socket->state() == QLocalSocket::ConnectedState) {
+                socket->waitForReadyRead(0);
+            }
+            readResults(socket);
+        }
+    }
+
+    Shard &state = shards[shard];
+    if ((state.isFinished) ||
+        ((state.process) && (state.process->state() != QProcess::NotRunning)) ||
+        ((state.socket) && (state.socket->state() != QLocalSocket::UnconnectedState))) {
+        return; // Still running, or already done.
+    }
+    if (state.socket) {
+        readResults(state.socket);
+    }
+    if (state.process) {
+        state.process->deleteLater();
+    }
+
+    QStringList remaining;
+    for (const QString &account: state.accounts) {
+        if (!exitCodes.contains(account)) {
+            remaining.append(account);
+        }
+    }
+
+    if ((!remaining.isEmpty()) && (state.restarts < maxRestarts)) {
+        ++state.restarts;
+        qWarning().noquote() << "Restarting worker for" << remaining.size() << "unfinished accounts"
+                             << QStringLiteral("(restart %1 of %2)").arg(state.restarts)
+                                .arg(maxRestarts);
+        state.accounts = remaining;
+        startWorker(shard);
+        return;
+    }
+
+    for (const QString &account: remaining) {
+        qCritical().noquote() << "Giving up on account" << account;
+        exitCodes.insert(account, EXIT_FAILURE);
+        runSummary.insert(QStringLiteral("%1:run").arg(account), QStringLiteral("error"),
+                          QStringLiteral("worker exited without a result"));
+    }
+    state.isFinished = true;
+
+    // Once all shards are finished, report the overall result.
+    int exitCode = EXIT_SUCCESS;
+    for (const Shard &other: shards) {
+        if (!other.isFinished) {
+            return;
+        }
+    }
+    for (auto iter = exitCodes.constBegin(); iter != exitCodes.constEnd(); ++iter) {
+        if (iter.value() != EXIT_SUCCESS) {
+            exitCode = iter.value();
+        }
+    }
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("accounts"), exitCodes.size());
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("exitCode"), exitCode);
+    emit finished(exitCode);
+}
+
+// Protected Slots
+
+void Coordinator::onNewConnection()
+{
+    while (QLocalSocket * const socket = server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            readResults(socket);
+        });
+        connect(socket, &QLocalSocket::disconnected, this, [this, socket]() {
+            readResults(socket);
+            for (int shard = 0; shard < shards.size(); ++shard) {
+                if (shards.at(shard).socket == socket) {
+                    shards[shard].socket = Q_NULLPTR;
+                    updateShard(shard);
+                }
+            }
+            socket->deleteLater();
+        });
+    }
+}
@@ -0,0 +1,82 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <QLocalServer>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QProcess>
+#include <QStringList>
+#include <QVector>
+
+#include "runsummary.h"
+
+class QLocalSocket;
+
+class Coordinator : public QObject
+{
+    Q_OBJECT
+
+public:
+    Coordinator(const QStringList &credentialFiles, const int workerCount,
+                const QStringList &workerArguments, QObject * parent = Q_NULLPTR);
+    virtual ~Coordinator();
+
+    void setMaxRestarts(const int restarts);
+
+    RunSummary summary() const;
+
+public slots:
+    void start();
+
+protected:
+    void processResult(const QByteArray &line);
+    void readResults(QLocalSocket * socket);
+    void startWorker(const int shard);
+    void updateShard(const int shard);
+
+protected slots:
+    void onNewConnection();
+
+private:
+    struct Shard {
+        QStringList accounts;
+        QPointer<QProcess> process;
+        QPointer<QLocalSocket> socket;
+        int restarts;
+        bool isFinished;
+        Shard() : restarts(0), isFinished(false) { }
+    };
+
+    const QStringList workerArguments;
+    int maxRestarts;
+    QLocalServer server;
+    QVector<Shard> shards;
+    QMap<QString, int> exitCodes; // Account name -> exit code.
+    RunSummary runSummary;
+
+signals:
+    void finished(const int exitCode);
+
+};
+
+#endif // COORDINATOR_H
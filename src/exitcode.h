@@ -0,0 +1,40 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXITCODE_H
+#define EXITCODE_H
+
+#include <cstdlib>
+
+// Process exit codes, distinct per failure class, so cron jobs (and the like) can tell them apart.
+namespace ExitCode {
+    enum {
+        Success         = EXIT_SUCCESS,
+        Failure         = EXIT_FAILURE, // Any failure not covered below.
+        LoadTimeout     = 3,
+        LoginTimeout    = 4,
+        ExtractTimeout  = 5,
+        SaveTimeout     = 6,
+        OverallTimeout  = 7,
+        RendererCrashed = 8,
+        MemoryLimit     = 9,
+    };
+}
+
+#endif // EXITCODE_H
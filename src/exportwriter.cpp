@@ -0,0 +1,149 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QIODevice>
+#include <QJsonDocument>
+
+#include "exportwriter.h"
+
+// Buffer this much output before writing it to the device.
+#define BUFFER_BYTES (64 * 1024)
+
+/*!
+ * Constructs a writer of sync history entries to \a device, in \a format. Output is buffered, and
+ * written to the device in large chunks, re-using the same buffer throughout, so that exporting
+ * any number of entries takes constant memory.
+ */
+ExportWriter::ExportWriter(QIODevice * device, const Format format)
+    : device(device), format(format), entries(0), failed(false)
+{
+    buffer.reserve(BUFFER_BYTES + 1024); // Also marks the capacity as reserved; see flush().
+    if (format == Format::Csv) {
+        buffer.append("time,account,date,weight,bodyFat,written,source,status\n");
+    }
+}
+
+ExportWriter::~ExportWriter()
+{
+    flush();
+}
+
+/*!
+ * Returns the number of entries written (though possibly still buffered) so far.
+ */
+qint64 ExportWriter::count() const
+{
+    return entries;
+}
+
+/*!
+ * Writes any buffered output to the device. Returns \c false if this, or any earlier write to the
+ * device, failed.
+ */
+bool ExportWriter::flush()
+{
+    if ((!failed) && (!buffer.isEmpty())) {
+        failed = (device->write(buffer) != buffer.size());
+        if (failed) {
+            qWarning() << "Failed to write export" << device->errorString();
+        }
+    }
+    buffer.resize(0); // Keeps the (reserved) capacity, so the buffer is never reallocated.
+    return !failed;
+}
+
+/*!
+ * Appends \a entry to the output. Returns \c false if writing to the device has failed, in which
+ * case there's no point writing any more.
+ */
+bool ExportWriter::write(const SyncHistory::Entry &entry)
+{
+    switch (format) {
+    case Format::Csv:
+        buffer.append(entry.time.toUTC().toString(Qt::ISODateWithMs).toLatin1());
+        buffer.append(',');
+        appendCsvField(entry.account);
+        buffer.append(',');
+        buffer.append(entry.measurement.id().toLatin1());
+        buffer.append(',');
+        appendCsvNumber(SyncHistory::reported(entry.measurement.weight));
+        buffer.append(',');
+        appendCsvNumber(SyncHistory::reported(entry.measurement.bodyFat));
+        buffer.append(',');
+        appendCsvNumber(entry.written);
+        buffer.append(',');
+        appendCsvField(entry.source);
+        buffer.append(',');
+        appendCsvField(entry.status);
+        buffer.append('\n');
+        break;
+    case Format::JsonLines:
+        buffer.append(QJsonDocument(SyncHistory::toJson(entry)).toJson(QJsonDocument::Compact));
+        buffer.append('\n');
+        break;
+    }
+    ++entries;
+    return ((buffer.size() < BUFFER_BYTES) || (flush()));
+}
+
+bool ExportWriter::parseFormat(const QString &string, Format &format)
+{
+    if (string == QStringLiteral("csv")) {
+        format = Format::Csv;
+    } else if (string == QStringLiteral("jsonl")) {
+        format = Format::JsonLines;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Protected Methods
+
+/*!
+ * Appends \a value as a CSV field, quoted (per RFC 4180) only if it needs to be.
+ */
+void ExportWriter::appendCsvField(const QString &value)
+{
+    const QByteArray utf8 = value.toUtf8();
+    if ((!utf8.contains(',')) && (!utf8.contains('"')) && (!utf8.contains('\n')) &&
+        (!utf8.contains('\r'))) {
+        buffer.append(utf8);
+        return;
+    }
+    buffer.append('"');
+    for (const char c: utf8) {
+        if (c == '"') {
+            buffer.append('"');
+        }
+        buffer.append(c);
+    }
+    buffer.append('"');
+}
+
+/*!
+ * Appends \a value as a CSV field, or an empty field if \a value is zero (ie, not known).
+ */
+void ExportWriter::appendCsvNumber(const double value)
+{
+    if (value > 0) {
+        buffer.append(QByteArray::number(value, 'g', 10));
+    }
+}
@@ -0,0 +1,61 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef EXPORTWRITER_H
+#define EXPORTWRITER_H
+
+#include <QByteArray>
+
+#include "synchistory.h"
+
+class QIODevice;
+
+class ExportWriter
+{
+
+public:
+    enum class Format {
+        Csv,
+        JsonLines,
+    };
+
+    ExportWriter(QIODevice * device, const Format format);
+    virtual ~ExportWriter();
+
+    qint64 count() const;
+
+    bool flush();
+    bool write(const SyncHistory::Entry &entry);
+
+    static bool parseFormat(const QString &string, Format &format);
+
+protected:
+    void appendCsvField(const QString &value);
+    void appendCsvNumber(const double value);
+
+private:
+    QIODevice * device;
+    Format format;
+    QByteArray buffer;
+    qint64 entries;
+    bool failed;
+
+};
+
+#endif // EXPORTWRITER_H
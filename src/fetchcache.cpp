@@ -0,0 +1,148 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QSettings>
+
+#include "fetchcache.h"
+
+/*!
+ * Load the last fetched measurement (if any) stored under \a group in the \a fileName state file.
+ */
+FetchCache::FetchCache(const QString &fileName, const QString &group)
+    : fileName(fileName), group(group), daily(false), ttlSecs(0)
+{
+    if (fileName.isEmpty()) {
+        return; // Persistence disabled.
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    settings.beginGroup(group);
+    cached.date = settings.value(QStringLiteral("date")).toDateTime();
+    cached.weight = settings.value(QStringLiteral("weight"), 0.0f).toFloat();
+    cached.bodyFat = settings.value(QStringLiteral("bodyFat"), 0.0f).toFloat();
+    lastFetched = settings.value(QStringLiteral("fetched")).toDateTime();
+}
+
+QDateTime FetchCache::fetched() const
+{
+    return lastFetched;
+}
+
+Measurement FetchCache::measurement() const
+{
+    return cached;
+}
+
+/*!
+ * Skip fetching once a measurement dated today (local time) has been cached.
+ */
+void FetchCache::setDaily(const bool daily)
+{
+    this->daily = daily;
+}
+
+/*!
+ * Skip fetching if the cached measurement was fetched less than \a secs ago. A \a secs of zero, or
+ * less, disables the TTL.
+ */
+void FetchCache::setTtl(const qint64 secs)
+{
+    ttlSecs = secs;
+}
+
+/*!
+ * Only fetch between the \a start and \a end times of day (local time). If \a end is earlier than
+ * \a start, the window spans midnight. Invalid times disable the window.
+ */
+void FetchCache::setWindow(const QTime &start, const QTime &end)
+{
+    windowStart = start;
+    windowEnd = end;
+}
+
+/*!
+ * Returns \c true if the cache policy says that no fetch is required right now, in which case the
+ * human readable \a reason (if not null) is set too.
+ */
+bool FetchCache::skipFetch(QString * reason) const
+{
+    #define SKIP_BECAUSE(why) { if (reason) *reason = why; return true; }
+    const QDateTime now = QDateTime::currentDateTime();
+
+    if ((windowStart.isValid()) && (windowEnd.isValid())) {
+        const QTime time = now.time();
+        const bool inWindow = (windowStart <= windowEnd)
+            ? ((windowStart <= time) && (time < windowEnd))
+            : ((windowStart <= time) || (time < windowEnd));
+        if (!inWindow) {
+            SKIP_BECAUSE(QStringLiteral("outside of the %1-%2 measurement window")
+                .arg(windowStart.toString(QStringLiteral("HH:mm")),
+                     windowEnd.toString(QStringLiteral("HH:mm"))));
+        }
+    }
+
+    if (!cached.isValid()) {
+        return false;
+    }
+
+    if ((ttlSecs > 0) && (lastFetched.isValid()) && (lastFetched.secsTo(now) < ttlSecs)) {
+        SKIP_BECAUSE(QStringLiteral("last fetched %1 seconds ago").arg(lastFetched.secsTo(now)));
+    }
+
+    if ((daily) && (cached.date.toLocalTime().date() == now.date())) {
+        SKIP_BECAUSE(QStringLiteral("already have today's measurement (%1)")
+            .arg(cached.date.toString(Qt::ISODate)));
+    }
+    #undef SKIP_BECAUSE
+    return false;
+}
+
+void FetchCache::save(const Measurement &measurement)
+{
+    cached = measurement;
+    lastFetched = QDateTime::currentDateTime();
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    settings.beginGroup(group);
+    settings.setValue(QStringLiteral("date"), cached.date);
+    settings.setValue(QStringLiteral("weight"), cached.weight);
+    settings.setValue(QStringLiteral("bodyFat"), cached.bodyFat);
+    settings.setValue(QStringLiteral("fetched"), lastFetched);
+    settings.endGroup();
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qWarning() << "Failed to save fetch cache to" << fileName << settings.status();
+    }
+}
+
+/*!
+ * Parse a measurement window \a string, such as "06:00-10:00", into its \a start and \a end times.
+ */
+bool FetchCache::parseWindow(const QString &string, QTime &start, QTime &end)
+{
+    const QStringList parts = string.split(QLatin1Char('-'));
+    if (parts.size() != 2) {
+        return false;
+    }
+    start = QTime::fromString(parts.at(0).trimmed(), QStringLiteral("H:mm"));
+    end = QTime::fromString(parts.at(1).trimmed(), QStringLiteral("H:mm"));
+    return ((start.isValid()) && (end.isValid()));
+}
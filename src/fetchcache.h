@@ -0,0 +1,58 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef FETCHCACHE_H
+#define FETCHCACHE_H
+
+#include <QDateTime>
+#include <QString>
+
+#include "measurement.h"
+
+class FetchCache
+{
+
+public:
+    FetchCache(const QString &fileName, const QString &group);
+
+    QDateTime fetched() const;
+    Measurement measurement() const;
+
+    void setDaily(const bool daily);
+    void setTtl(const qint64 secs);
+    void setWindow(const QTime &start, const QTime &end);
+
+    bool skipFetch(QString * reason = Q_NULLPTR) const;
+    void save(const Measurement &measurement);
+
+    static bool parseWindow(const QString &string, QTime &start, QTime &end);
+
+private:
+    QString fileName;
+    QString group;
+    Measurement cached;
+    QDateTime lastFetched;
+    bool daily;
+    qint64 ttlSecs;
+    QTime windowStart;
+    QTime windowEnd;
+
+};
+
+#endif // FETCHCACHE_H
@@ -17,34 +17,55 @@
     along with Float.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <QCoreApplication>
 #include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QPointer>
 #include <QWebEngineProfile>
 #include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
 
-#include <QTimer>
-
+#include "exitcode.h"
 #include "fitbit.h"
 #include "observablewebpage.h"
+#include "readinessmonitor.h"
 
 #define FITBIT_WEIGHT_URL QStringLiteral("https://www.fitbit.com/weight")
 
-Fitbit::Fitbit(const QString &username, const QString &password, QObject * parent)
-    :  QObject(parent), username(username), password(password), scriptBusy(false)
-{
-    // Create a new web page, with an 'anonymous' profile (unshared, in-memory cookies, etc).
-    page = new ObservableWebPage(new QWebEngineProfile, this);
-    page->profile()->setParent(this); // Done post-construction to ensure deletion *after* page.
-    Q_ASSERT(page->profile()->isOffTheRecord());
+// Matches the URLs of the Fitbit web app's weight log requests (eg /1/user/-/body/log/weight/...).
+#define FITBIT_WEIGHT_LOG_PATTERN QStringLiteral("/body/log/weight")
+
+#define DATA_HOOK_CHANNEL QStringLiteral("weightLog")
+#define DATA_HOOK_SCRIPT_NAME QStringLiteral("fitbitDataHook")
+
+// Give up once the page's requests have settled this many times without revealing the weight.
+#define MAX_IDLE_WAITS 20
 
+/*!
+ * Construct a Fitbit session for \a username and \a password, using \a profile (which must be
+ * off-the-record, and outlive this object), or else a new profile of its own.
+ */
+Fitbit::Fitbit(const QString &username, const QString &password, QWebEngineProfile * profile,
+               QObject * parent)
+    :  QObject(parent), profile(profile), page(Q_NULLPTR), readiness(Q_NULLPTR),
 #ifdef USE_WEB_ENGINE_VIEW
-    // Create a web engine view (if we're using one), and assign our custom web page.
-    view = new QWebEngineView();
-    view->setPage(page);
+       view(Q_NULLPTR),
 #endif
+       username(username), password(password), scriptBusy(false), extraction(Extraction::Auto),
+       weightIsFound(false), idleWaits(0), retries(0), maxRetries(0)
+{
+    // Unless given one (eg, already warmed up), create an 'anonymous' profile (unshared, in-memory
+    // cookies, etc). The profile outlives any pages we create (and recreate) with it, so the login
+    // session survives page recreation.
+    if (!this->profile) {
+        this->profile = new QWebEngineProfile(this);
+    }
+    Q_ASSERT(this->profile->isOffTheRecord());
 
-    connect(page, &ObservableWebPage::loadFinished, this, &Fitbit::onLoadFinshed);
-    connect(page, &ObservableWebPage::mutationObserved, this, &Fitbit::onMutation);
+    stages = new StageTimer(this);
+    connect(stages, &StageTimer::expired, this, &Fitbit::onStageExpired);
+
+    createPage();
 }
 
 Fitbit::~Fitbit()
@@ -52,13 +73,166 @@ Fitbit::~Fitbit()
 #ifdef USE_WEB_ENGINE_VIEW
     delete view;
 #endif
-    delete page;
+    // Delete all pages (including any retired ones) explicitly, to ensure their deletion *before*
+    // the profile's.
+    qDeleteAll(findChildren<ObservableWebPage *>(QString(), Qt::FindDirectChildrenOnly));
+}
+
+QWebEnginePage * Fitbit::webPage() const
+{
+    return page;
+}
+
+/*!
+ * Set how the weight log is to be extracted from the Fitbit web app. Unless \a extraction is
+ * Extraction::Dom, a script is injected at document creation that captures the body of any fetch
+ * or XHR response whose URL matches \a dataUrl (or a default Fitbit weight log pattern, if
+ * invalid or empty), so the weight can be extracted long before the page has rendered it.
+ */
+void Fitbit::setExtraction(const Extraction extraction, const QRegularExpression &dataUrl)
+{
+    this->extraction = extraction;
+    this->dataUrl = dataUrl;
+    const QWebEngineScript existing = page->scripts().findScript(DATA_HOOK_SCRIPT_NAME);
+    if (!existing.isNull()) {
+        page->scripts().remove(existing);
+    }
+    if (extraction == Extraction::Dom) {
+        return;
+    }
+
+    // Note, this must run in the main world, so that it wraps the page's own fetch / XHR objects.
+    QWebEngineScript script;
+    script.setName(DATA_HOOK_SCRIPT_NAME);
+    script.setInjectionPoint(QWebEngineScript::DocumentCreation);
+    script.setWorldId(QWebEngineScript::MainWorld);
+    script.setRunsOnSubFrames(false);
+    script.setSourceCode(QStringLiteral(R"JS(
+        (function () {
+            const debug = console.debug.bind(console); // In case the app silences the console.
+            const pattern = new RegExp(%2);
+            // Returns the Accept-Language header of a fetch request, which sets the weight units.
+            const locale = function (input, init) {
+                try {
+                    return new Headers(((init) && (init.headers)) ||
+                        ((input instanceof Request) ? input.headers : undefined))
+                        .get('Accept-Language') || '';
+                } catch (error) {
+                    return '';
+                }
+            };
+            const report = function (text, locale) {
+                let data;
+                try {
+                    data = JSON.parse(text);
+                } catch (error) {
+                    return;
+                }
+                // Find any objects with numeric weights, and string dates, in the response.
+                const entries = [];
+                const search = function (value, depth) {
+                    if ((depth > 8) || (value === null) || (typeof value !== 'object')) {
+                        return;
+                    }
+                    if ((typeof value.weight === 'number') && (typeof value.date === 'string')) {
+                        entries.push({ date: value.date, time: value.time || '',
+                                       weight: value.weight, fat: value.fat || 0,
+                                       locale: locale || '' });
+                        return;
+                    }
+                    Object.keys(value).forEach((key) => search(value[key], depth + 1));
+                };
+                search(data, 0);
+                if (entries.length) {
+                    debug('%1' + JSON.stringify(entries));
+                }
+            };
+
+            const fetch = window.fetch;
+            if (fetch) {
+                window.fetch = function (input, init) {
+                    const requestLocale = locale(input, init);
+                    return fetch.apply(this, arguments).then(function (response) {
+                        if (pattern.test(response.url)) {
+                            response.clone().text().then(
+                                (text) => report(text, requestLocale), () => {});
+                        }
+                        return response;
+                    });
+                };
+            }
+
+            const open = XMLHttpRequest.prototype.open;
+            XMLHttpRequest.prototype.open = function () {
+                this.addEventListener('load', function () {
+                    if (pattern.test(this.responseURL)) {
+                        report((this.responseType === 'json')
+                            ? JSON.stringify(this.response) : this.responseText, this.locale);
+                    }
+                });
+                return open.apply(this, arguments);
+            };
+            const setRequestHeader = XMLHttpRequest.prototype.setRequestHeader;
+            XMLHttpRequest.prototype.setRequestHeader = function (name, value) {
+                if (String(name).toLowerCase() === 'accept-language') {
+                    this.locale = String(value);
+                }
+                return setRequestHeader.apply(this, arguments);
+            };
+        })();
+    )JS").arg(page->channelPrefix(DATA_HOOK_CHANNEL), javaScriptLiteral(dataUrlPattern())));
+    page->scripts().insert(script);
+}
+
+/*!
+ * Parse an \a extraction mode \a string ("auto", "data" or "dom").
+ */
+bool Fitbit::parseExtraction(const QString &string, Extraction &extraction)
+{
+    if (string == QStringLiteral("auto")) {
+        extraction = Extraction::Auto;
+    } else if (string == QStringLiteral("data")) {
+        extraction = Extraction::Data;
+    } else if (string == QStringLiteral("dom")) {
+        extraction = Extraction::Dom;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * Returns the origin of the Fitbit web app.
+ */
+QUrl Fitbit::origin()
+{
+    return QUrl(FITBIT_WEIGHT_URL).adjusted(QUrl::RemovePath);
+}
+
+/*!
+ * Recreate the page, and start over, up to \a count times if a stage exceeds its budget, or the
+ * renderer process crashes.
+ */
+void Fitbit::setMaxRetries(const int count)
+{
+    maxRetries = count;
+}
+
+/*!
+ * Set the wall-clock budget, in milliseconds, of each stage of fetching the weight.
+ */
+void Fitbit::setStageBudgets(const QMap<StageTimer::Stage, int> &msecs)
+{
+    stages->setBudgets(msecs);
 }
 
 // Public Slots
 
 void Fitbit::fetchWeight()
 {
+    weightIsFound = false;
+    idleWaits = 0;
+    stages->start(StageTimer::Load);
 #ifdef USE_WEB_ENGINE_VIEW
     Q_ASSERT(view);
     view->load(FITBIT_WEIGHT_URL);
@@ -70,6 +244,66 @@ void Fitbit::fetchWeight()
 
 // Protected Methods
 
+/*!
+ * Returns the pattern matching the URLs of the weight log responses to extract data from; that is,
+ * the extraction data URL, or a default Fitbit weight log pattern if that is invalid or empty.
+ */
+QString Fitbit::dataUrlPattern() const
+{
+    return ((dataUrl.isValid()) && (!dataUrl.pattern().isEmpty()))
+        ? dataUrl.pattern() : FITBIT_WEIGHT_LOG_PATTERN;
+}
+
+/*!
+ * Create (or recreate) the web page, and its view (if using one).
+ */
+void Fitbit::createPage()
+{
+    if (page) {
+        // We may be here via one of the old page's signals, so don't delete it just yet.
+        page->disconnect(this);
+#ifdef USE_WEB_ENGINE_VIEW
+        view->deleteLater();
+#endif
+        page->deleteLater();
+    }
+    scriptBusy = false;
+
+    page = new ObservableWebPage(profile, this);
+    readiness = new ReadinessMonitor(page);
+
+#ifdef USE_WEB_ENGINE_VIEW
+    // Create a web engine view (if we're using one), and assign our custom web page.
+    view = new QWebEngineView();
+    view->setPage(page);
+#endif
+
+    connect(page, &ObservableWebPage::channelMessage, this, &Fitbit::onChannelMessage);
+    connect(page, &ObservableWebPage::loadFinished, this, &Fitbit::onLoadFinshed);
+    connect(page, &ObservableWebPage::renderProcessTerminated,
+            this, &Fitbit::onRenderProcessTerminated);
+    setExtraction(extraction, dataUrl);
+    emit pageChanged(page);
+}
+
+/*!
+ * Recreate the page and start over, unless we've already retried too many times, in which case
+ * fail with \a reason and \a exitCode.
+ */
+void Fitbit::retry(const QString &reason, const int exitCode)
+{
+    if (retries >= maxRetries) {
+        stages->stop();
+        emit failed(reason, exitCode);
+        return;
+    }
+    ++retries;
+    qWarning().noquote() << reason << QStringLiteral("; retrying (%1 of %2)")
+                                      .arg(retries).arg(maxRetries);
+    createPage();
+    fetchWeight();
+}
+
 float Fitbit::parseBodyFat(const QString &string)
 {
     // Fitbit.com examples: "23% Fat", "22.6% Fat".
@@ -113,6 +347,43 @@ QDateTime Fitbit::parseDate(const QString &string)
     return QDateTime();
 }
 
+/*!
+ * Returns the most recent of the weight log \a entries captured from Fitbit response data.
+ *
+ * Each entry is an object with an ISO 8601 \c date (eg "2019-09-19"), optional \c time
+ * (eg "08:41:00"), numeric \c weight and numeric \c fat (percent), along with the \c locale of
+ * the request's Accept-Language header (if any). Fitbit reports weights in the unit system of that
+ * locale: pounds for en_US, stone for en_GB, and kilograms otherwise (including when there is no
+ * such header). Since Polar Flow takes kilograms, entries in non-metric units are ignored.
+ */
+Measurement Fitbit::parseWeightLog(const QJsonArray &entries)
+{
+    static const QRegularExpression nonMetricLocale(QStringLiteral("^en[_-](US|GB)\\b"),
+                                                    QRegularExpression::CaseInsensitiveOption);
+    Measurement newest;
+    for (const QJsonValue &value: entries) {
+        const QJsonObject entry = value.toObject();
+        const QString locale = entry.value(QStringLiteral("locale")).toString();
+        if (nonMetricLocale.match(locale).hasMatch()) {
+            qWarning().noquote() << "Ignoring weight log data in non-metric units for" << locale;
+            continue;
+        }
+        Measurement measurement;
+        measurement.date = QDateTime(
+            QDate::fromString(entry.value(QStringLiteral("date")).toString(), Qt::ISODate),
+            QTime::fromString(entry.value(QStringLiteral("time")).toString(), Qt::ISODate));
+        if (!measurement.date.time().isValid()) {
+            measurement.date.setTime(QTime(0, 0));
+        }
+        measurement.weight = static_cast<float>(entry.value(QStringLiteral("weight")).toDouble());
+        measurement.bodyFat = static_cast<float>(entry.value(QStringLiteral("fat")).toDouble());
+        if ((measurement.isValid()) && ((!newest.isValid()) || (measurement.date > newest.date))) {
+            newest = measurement;
+        }
+    }
+    return newest;
+}
+
 float Fitbit::parseWeigth(const QString &string)
 {
     // Fitbit.com examples: "79.3 kg", "80.4 kg", "78 kg"
@@ -141,6 +412,15 @@ QString Fitbit::javaScriptLiteral(QString string, QChar quote)
         + quote;
 }
 
+/*!
+ * Move on to the next step as soon as \a condition is met. Note, the conditions themselves have no
+ * deadlines; the stage budgets cover the time spent waiting for them instead.
+ */
+void Fitbit::waitFor(ReadinessCondition * condition)
+{
+    connect(condition, &ReadinessCondition::met, this, &Fitbit::nextStep);
+}
+
 // Protected Slots
 
 void Fitbit::nextStep()
@@ -151,6 +431,7 @@ void Fitbit::nextStep()
     }
 
     scriptBusy = true;
+    const QPointer<ObservableWebPage> source(page);
     page->runJavaScript(
         QStringLiteral(R"JS(
             function nextStep() {
@@ -174,7 +455,7 @@ void Fitbit::nextStep()
                 }
 
                 const weightListItem = document.querySelector('.weight-list-item');
-                if (weightListItem) {
+                if ((weightListItem) && (%3)) {
                     console.trace('Reading weight item');
                     result = {
                         date: weightListItem.querySelector('.weight-list-item-date-text').innerText,
@@ -194,37 +475,109 @@ void Fitbit::nextStep()
                const result = { error: { name: error.name, message: error.message } };
                result;
             }
-        )JS").arg(javaScriptLiteral(username), javaScriptLiteral(password)),
-        QWebEngineScript::ApplicationWorld, [this](const QVariant &result) {
+        )JS").arg(javaScriptLiteral(username), javaScriptLiteral(password),
+                  QLatin1String((extraction == Extraction::Data) ? "false" : "true")),
+        QWebEngineScript::ApplicationWorld, [this, source](const QVariant &result) {
             qDebug() << "JavaScript result" << result;
+            if (source != page) {
+                return; // The page has since been recreated.
+            }
+            if (weightIsFound) {
+                scriptBusy = false;
+                return; // Already found via the page's response data.
+            }
 
             // Stop on errors.
             const QVariantMap error = result.toMap().value(QStringLiteral("error")).toMap();
             if (!error.isEmpty()) {
                 qCritical().noquote() << error.value(QLatin1String("name")).toString()
                                       << error.value(QLatin1String("message")).toString();
-                QCoreApplication::exit(EXIT_FAILURE);
+                scriptBusy = false;
+                stages->stop();
+                emit failed(error.value(QLatin1String("message")).toString(), ExitCode::Failure);
                 return;
             }
 
+            // Having just submitted the login form, wait for the weight log response (when
+            // extracting from response data only), or else for the weight list to render.
+            if ((result.type() == QVariant::Bool) && (result.toBool())) {
+                scriptBusy = false;
+                waitFor((extraction == Extraction::Data)
+                    ? readiness->waitForResponse(QRegularExpression(dataUrlPattern()), 0)
+                    : readiness->waitForSelector(QStringLiteral(".weight-list-item"), 0));
+                return;
+            }
+
+            // If there was nothing useful yet, try again once the page's requests settle, but
+            // only so many times, since an idle page may never reveal the weight.
             const QVariantMap map = result.toMap();
-            if (!map.isEmpty()) {
-                const QDateTime date = parseDate(map.value(QLatin1String("date")).toString());
-                const float bodyFat = parseBodyFat(map.value(QLatin1String("bodyFat")).toString());
-                const float weight = parseWeigth(map.value(QLatin1String("weight")).toString());
-                qDebug() << "Found weight:" << date << bodyFat << weight;
-                if (date.daysTo(QDateTime::currentDateTime()) > 7) {
-                    qWarning() << "Weight date is too old:" << date;
-                    QCoreApplication::exit(EXIT_FAILURE);
+            if (map.isEmpty()) {
+                scriptBusy = false;
+                if (++idleWaits > MAX_IDLE_WAITS) {
+                    qWarning() << "Gave up waiting for the weight after" << MAX_IDLE_WAITS
+                               << "network idle periods";
+                    stages->stop();
+                    emit failed(QStringLiteral("Failed to find the weight on the Fitbit page"),
+                                ExitCode::Failure);
+                    return;
                 }
-                emit weightFound(weight);
+                waitFor(readiness->waitForNetworkIdle(500, 0));
+                return;
             }
 
+            Measurement measurement;
+            measurement.date = parseDate(map.value(QLatin1String("date")).toString());
+            measurement.bodyFat = parseBodyFat(map.value(QLatin1String("bodyFat")).toString());
+            measurement.weight = parseWeigth(map.value(QLatin1String("weight")).toString());
+            qDebug() << "Found weight:" << measurement.date << measurement.bodyFat
+                     << measurement.weight;
+            if (measurement.date.daysTo(QDateTime::currentDateTime()) > 7) {
+                qWarning() << "Weight date is too old:" << measurement.date;
+                scriptBusy = false;
+                stages->stop();
+                emit failed(QStringLiteral("Weight date is too old: %1")
+                            .arg(measurement.date.toString(Qt::ISODate)), ExitCode::Failure);
+                return;
+            }
+            weightIsFound = true;
+            stages->stop();
+            emit weightFound(measurement);
+
             scriptBusy = false;
         }
     );
 }
 
+void Fitbit::onChannelMessage(const QString &channel, const QJsonValue &payload)
+{
+    if ((channel != DATA_HOOK_CHANNEL) || (weightIsFound)) {
+        return;
+    }
+    const Measurement measurement = parseWeightLog(payload.toArray());
+    qDebug() << "Found weight in response data:" << measurement.date << measurement.bodyFat
+             << measurement.weight;
+    if (!measurement.isValid()) {
+        return;
+    }
+    if (measurement.date.daysTo(QDateTime::currentDateTime()) > 7) {
+        if (extraction != Extraction::Data) {
+            qDebug() << "Ignoring old weight log data:" << measurement.date;
+            return; // Probably not the latest page of the log; let the DOM (or more data) decide.
+        }
+        // With no DOM extraction to fall back on, fail just as the DOM extraction would.
+        qWarning() << "Weight date is too old:" << measurement.date;
+        readiness->cancelAll();
+        stages->stop();
+        emit failed(QStringLiteral("Weight date is too old: %1")
+                    .arg(measurement.date.toString(Qt::ISODate)), ExitCode::Failure);
+        return;
+    }
+    weightIsFound = true;
+    readiness->cancelAll();
+    stages->stop();
+    emit weightFound(measurement);
+}
+
 void Fitbit::onLoadFinshed(const bool ok)
 {
     qDebug() << "Finished loading" << page->url().toString() << ok;
@@ -235,17 +588,37 @@ void Fitbit::onLoadFinshed(const bool ok)
         return;
     }
 
-    // Begin observing changes to the page's body (only top-level children).
-    ObservableWebPage::ObserveOptions options;
-    options.childList = true;
-    page->observeByTagName(QStringLiteral("'body'"), options);
+    // Time the login stage from when the login form renders, and the extract stage from when the
+    // weight page itself loads, so a slow login page is not mistaken for a slow extraction.
+    readiness->cancelAll();
+    const QUrl weightUrl(FITBIT_WEIGHT_URL);
+    if ((page->url().host() == weightUrl.host()) &&
+        (page->url().path().startsWith(weightUrl.path()))) {
+        stages->start(StageTimer::Extract);
+    } else {
+        connect(readiness->waitForSelector(QStringLiteral("#loginForm"), 0),
+                &ReadinessCondition::met, stages, [this]() {
+            stages->start(StageTimer::Login);
+        });
+    }
+
+    // Move the browser to the next step once the page has rendered either the login form, or the
+    // weight list, rather than re-checking on every incidental DOM change.
+    waitFor(readiness->waitForSelector(QStringLiteral("#loginForm, .weight-list-item"), 0));
+}
 
-    // Move the browser to the next step.
-    nextStep();
+void Fitbit::onRenderProcessTerminated(
+    const QWebEnginePage::RenderProcessTerminationStatus status, const int exitCode)
+{
+    if (status == QWebEnginePage::NormalTerminationStatus) {
+        return;
+    }
+    retry(QStringLiteral("Fitbit renderer process terminated abnormally (status %1, exit code %2)")
+          .arg(status).arg(exitCode), ExitCode::RendererCrashed);
 }
 
-void Fitbit::onMutation(const QJsonObject &mutation)
+void Fitbit::onStageExpired(const StageTimer::Stage stage)
 {
-    Q_UNUSED(mutation)
-    nextStep();
+    retry(QStringLiteral("Fitbit %1 stage timed out").arg(StageTimer::stageName(stage)),
+          StageTimer::exitCode(stage));
 }
@@ -17,10 +17,15 @@
     along with Float.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <QJsonArray>
 #include <QObject>
+#include <QRegularExpression>
 #include <QUrl>
 #include <QWebEnginePage>
 
+#include "measurement.h"
+#include "stagetimer.h"
+
 #define USE_WEB_ENGINE_VIEW
 
 #ifdef USE_WEB_ENGINE_VIEW
@@ -28,15 +33,35 @@
 #endif
 
 class ObservableWebPage;
+class QWebEngineProfile;
+class ReadinessCondition;
+class ReadinessMonitor;
 
 class Fitbit : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit Fitbit(const QString &username, const QString &password, QObject * parent = Q_NULLPTR);
+    enum class Extraction {
+        Auto, // Use whichever of the following is available first.
+        Data, // Capture the weight log from the page's fetch / XHR response data.
+        Dom,  // Scrape the weight log from the rendered page.
+    };
+
+    explicit Fitbit(const QString &username, const QString &password,
+                    QWebEngineProfile * profile = Q_NULLPTR, QObject * parent = Q_NULLPTR);
     virtual ~Fitbit();
 
+    QWebEnginePage * webPage() const;
+
+    void setExtraction(const Extraction extraction,
+                       const QRegularExpression &dataUrl = QRegularExpression());
+    static bool parseExtraction(const QString &string, Extraction &extraction);
+    static QUrl origin();
+
+    void setMaxRetries(const int count);
+    void setStageBudgets(const QMap<StageTimer::Stage, int> &msecs);
+
 public slots:
     void fetchWeight();
 
@@ -44,23 +69,43 @@ protected:
     static QString javaScriptLiteral(QString string, QChar quote = QChar());
     static float parseBodyFat(const QString &string);
     static QDateTime parseDate(const QString &string);
+    static Measurement parseWeightLog(const QJsonArray &entries);
     static float parseWeigth(const QString &string);
 
+    QString dataUrlPattern() const;
+    void createPage();
+    void retry(const QString &reason, const int exitCode);
+    void waitFor(ReadinessCondition * condition);
+
 protected slots:
     void nextStep();
+    void onChannelMessage(const QString &channel, const QJsonValue &payload);
     void onLoadFinshed(const bool ok);
-    void onMutation(const QJsonObject &mutation);
+    void onRenderProcessTerminated(const QWebEnginePage::RenderProcessTerminationStatus status,
+                                   const int exitCode);
+    void onStageExpired(const StageTimer::Stage stage);
 
 private:
+    QWebEngineProfile * profile;
     ObservableWebPage * page;
+    ReadinessMonitor * readiness;
+    StageTimer * stages;
 #ifdef USE_WEB_ENGINE_VIEW
     QWebEngineView * view;
 #endif
     QString username;
     QString password;
     bool scriptBusy;
+    Extraction extraction;
+    QRegularExpression dataUrl;
+    bool weightIsFound;
+    int idleWaits;
+    int retries;
+    int maxRetries;
 
 signals:
-    void weightFound(const float massInKgs);
+    void failed(const QString &reason, const int exitCode);
+    void pageChanged(QWebEnginePage * page);
+    void weightFound(const Measurement &measurement);
 
 };
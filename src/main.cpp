@@ -20,14 +20,36 @@
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QLoggingCategory>
-#include <QProcessEnvironment>
-#include <QSettings>
+#include <QScopedPointer>
+#include <QStandardPaths>
+#include <QTimer>
 
-#include "fitbit.h"
+#include "account.h"
+#include "controlclient.h"
+#include "controlserver.h"
+#include "coordinator.h"
+#include "exportwriter.h"
+#include "fetchcache.h"
 #include "polar.h"
+#include "stagetimer.h"
+#include "synchistory.h"
+#include "syncjob.h"
+#include "warmup.h"
+#include "webarchive.h"
+#include "webhookreceiver.h"
+#include "worker.h"
 
 void configureLogging(const QCommandLineParser &parser);
+int exportHistory(QCommandLineParser &parser);
+bool isUpToDate(const QList<Account> &accounts, const SyncJob::Options &options);
+QString stateFileName(const QCommandLineParser &parser, const QString &option = QString(),
+                      const QString &suffix = QString());
+SyncJob::Options syncOptions(QCommandLineParser &parser);
+QStringList workerArguments(const QCommandLineParser &parser);
 
 int main(int argc, char *argv[])
 {
@@ -45,6 +67,9 @@ int main(int argc, char *argv[])
         }
     }
 
+    // Register our custom URL scheme(s). This too must be done before QApplication is initialised.
+    WebArchive::registerScheme();
+
     // Initialise our Qt application.
     QApplication app(argc, argv);
     app.setApplicationVersion(QStringLiteral("0.0.1"));
@@ -54,52 +79,458 @@ int main(int argc, char *argv[])
     parser.setApplicationDescription(QStringLiteral("Export weight from Fitbit to Polar Flow"));
     parser.addHelpOption();
     parser.addOptions({
+        { QStringLiteral("account"),
+          QStringLiteral("Limit --request or --export to the named account"),
+          QStringLiteral("name")},
         {{QStringLiteral("c"), QStringLiteral("credentials")},
           QStringLiteral("Read credentials from filename"),  QStringLiteral("filename")},
         {{QStringLiteral("d"), QStringLiteral("debug")}, QStringLiteral("Enable debug output")},
+        { QStringLiteral("deadline"),
+          QStringLiteral("Limit stage (load, login, extract, save or overall) to secs"),
+          QStringLiteral("stage=secs")},
+        { QStringLiteral("export"),
+          QStringLiteral("Export the sync history as format: csv or jsonl, then exit"),
+          QStringLiteral("format")},
+        { QStringLiteral("extraction"),
+          QStringLiteral("Extract Fitbit weight via mode: auto, data or dom (default auto)"),
+          QStringLiteral("mode"), QStringLiteral("auto")},
+        { QStringLiteral("extraction-url"),
+          QStringLiteral("Extract Fitbit data from responses with URLs matching regex"),
+          QStringLiteral("regex")},
+        { QStringLiteral("fetch-daily"),
+          QStringLiteral("Skip Fitbit once today's measurement has been fetched")},
+        { QStringLiteral("fetch-ttl"),
+          QStringLiteral("Skip Fitbit if last fetched within minutes"), QStringLiteral("minutes")},
+        { QStringLiteral("fetch-window"),
+          QStringLiteral("Only fetch from Fitbit within window (eg 06:00-10:00)"),
+          QStringLiteral("window")},
+        { QStringLiteral("history"),
+          QStringLiteral("Record the outcome of each sync in filename"),
+          QStringLiteral("filename")},
+        { QStringLiteral("journal"),
+          QStringLiteral("Journal pending Polar writes in filename"), QStringLiteral("filename")},
+        { QStringLiteral("memory-limit"),
+          QStringLiteral("Abort if browser memory use exceeds mebibytes"),
+          QStringLiteral("mebibytes")},
+        { QStringLiteral("max-restarts"),
+          QStringLiteral("Restart crashed workers up to count times (default 2)"),
+          QStringLiteral("count"), QStringLiteral("2")},
         { QStringLiteral("no-color"), QStringLiteral("Do not color the output")},
+        { QStringLiteral("no-warm-up"),
+          QStringLiteral("Do not warm up the web engine and connections at startup")},
+        { QStringLiteral("output"),
+          QStringLiteral("Export to filename (default - for stdout)"), QStringLiteral("filename"),
+          QStringLiteral("-")},
+        { QStringLiteral("outlier"),
+          QStringLiteral("Reject weights beyond sigmas of the trend's noise (default 4)"),
+          QStringLiteral("sigmas"), QStringLiteral("4")},
+        { QStringLiteral("record"),
+          QStringLiteral("Record all web requests and responses into directory"),
+          QStringLiteral("directory")},
+        { QStringLiteral("replay"),
+          QStringLiteral("Replay web responses from directory, instead of the network"),
+          QStringLiteral("directory")},
+        { QStringLiteral("replay-latency"),
+          QStringLiteral("Delay each replayed response by msecs"), QStringLiteral("msecs")},
+        { QStringLiteral("request"),
+          QStringLiteral("Request a sync from the server on the local socket name"),
+          QStringLiteral("name")},
+        { QStringLiteral("retries"),
+          QStringLiteral("Retry timed out or crashed pages up to count times (default 2)"),
+          QStringLiteral("count"), QStringLiteral("2")},
+        { QStringLiteral("sample-interval"),
+          QStringLiteral("Sample browser resource usage every msecs (default 1000)"),
+          QStringLiteral("msecs"), QStringLiteral("1000")},
+        { QStringLiteral("serve"),
+          QStringLiteral("Serve sync requests on the local socket name"), QStringLiteral("name")},
+        { QStringLiteral("significance"),
+          QStringLiteral("Only write trend changes beyond sigmas of its noise (default 2)"),
+          QStringLiteral("sigmas"), QStringLiteral("2")},
+        { QStringLiteral("smoothing"),
+          QStringLiteral("Smooth the weight trend by factor, 1 for none (default 0.25)"),
+          QStringLiteral("factor"), QStringLiteral("0.25")},
+        { QStringLiteral("state"), QStringLiteral("Persist sync state in filename"),
+          QStringLiteral("filename")},
+        { QStringLiteral("tolerance"),
+          QStringLiteral("Skip Polar if weight is within kgs of last write (default 0.05)"),
+          QStringLiteral("kgs"), QStringLiteral("0.05")},
+        { QStringLiteral("verify-after"),
+          QStringLiteral("Verify unchanged Polar weight after days (default 7, 0 to never)"),
+          QStringLiteral("days"), QStringLiteral("7")},
+        { QStringLiteral("webhook"),
+          QStringLiteral("Sync accounts on Fitbit notifications to local HTTP port"),
+          QStringLiteral("port")},
+        { QStringLiteral("workers"),
+          QStringLiteral("Sync multiple credentials files using count worker processes"),
+          QStringLiteral("count")},
         { QStringLiteral("show"), QStringLiteral("Show the web view on screen")},
     });
+    QCommandLineOption workerOption(QStringLiteral("worker"),
+        QStringLiteral("Report results to the coordinator's socket"), QStringLiteral("socket"));
+    workerOption.setFlags(QCommandLineOption::HiddenFromHelp);
+    parser.addOption(workerOption);
     parser.addVersionOption();
     parser.process(app);
     configureLogging(parser);
 
-    // Fetch the credentials.
-    #define FETCH_ENV(var, name) \
-        QString var = QProcessEnvironment::systemEnvironment().value(QLatin1String(#name))
-    FETCH_ENV(fitbitUser, FITBIT_USERNAME);
-    FETCH_ENV(fitbitPass, FITBIT_PASSWORD);
-    FETCH_ENV(polarUser, POLAR_USERNAME);
-    FETCH_ENV(polarPass, POLAR_PASSWORD);
-    qDebug() << parser.isSet(QStringLiteral("credentials"));
-    if (parser.isSet(QStringLiteral("credentials"))) {
-        qDebug() << parser.value(QStringLiteral("credentials"));
-        QSettings settings(parser.value(QStringLiteral("credentials")), QSettings::IniFormat);
-        qDebug() << settings.allKeys();
-        #define FETCH_SETTING(var, name) \
-            if (settings.contains(QLatin1String(#name))) \
-                var = settings.value(QLatin1String(#name)).toString()
-        FETCH_SETTING(fitbitUser, Fitbit/username);
-        FETCH_SETTING(fitbitPass, Fitbit/password);
-        FETCH_SETTING(polarUser, Polar/username);
-        FETCH_SETTING(polarPass, Polar/password);
-    }
-    #define REQUIRE_SETTING(var, name) \
-        if (var.isEmpty()) { \
-            qCritical().noquote() << "Option is required:" << QStringLiteral(#name); \
-            parser.showHelp(EXIT_FAILURE); \
+    // If we're a client, just request the sync from the server, and wait for the results.
+    if (parser.isSet(QStringLiteral("request"))) {
+        ControlClient client(parser.value(QStringLiteral("request")),
+                             parser.values(QStringLiteral("account")));
+        QObject::connect(&client, &ControlClient::finished, &app, &QCoreApplication::exit,
+                         Qt::QueuedConnection);
+        QTimer::singleShot(0, &client, &ControlClient::start);
+        const int result = app.exec();
+        client.summary().log();
+        return result;
+    }
+
+    // If we're exporting, just stream the sync history out, without starting the web engine.
+    if (parser.isSet(QStringLiteral("export"))) {
+        return exportHistory(parser);
+    }
+
+    // Unless coordinating workers (which never load any pages themselves), get the web engine, and
+    // name resolution, going while the options and credentials are processed.
+    const bool serving = (parser.isSet(QStringLiteral("serve"))) ||
+        (parser.isSet(QStringLiteral("webhook")));
+    const bool coordinating = (!parser.isSet(workerOption)) && (!serving) &&
+        ((parser.isSet(QStringLiteral("workers"))) ||
+         (parser.values(QStringLiteral("credentials")).size() > 1));
+    bool warmingUp = (!coordinating) && (!parser.isSet(QStringLiteral("no-warm-up"))) &&
+        (!parser.isSet(QStringLiteral("record"))) && (!parser.isSet(QStringLiteral("replay")));
+    Warmup warmup;
+    if (warmingUp) {
+        warmup.start({ Fitbit::origin(), Polar::origin() });
+    }
+
+    SyncJob::Options options = syncOptions(parser);
+
+    // Fetch the credentials; environment variables first, then any credentials file(s).
+    const Account environment = Account::fromEnvironment();
+    QList<Account> accounts;
+    for (const QString &fileName: parser.values(QStringLiteral("credentials"))) {
+        accounts.append(Account::fromFile(fileName, environment));
+    }
+    if (accounts.isEmpty()) {
+        accounts.append(environment);
+    }
+    for (const Account &account: accounts) {
+        const QStringList missing = account.missingSettings();
+        if (!missing.isEmpty()) {
+            qCritical().noquote() << "Option is required:" << missing.first()
+                                  << QStringLiteral("(%1)").arg(account.name);
+            parser.showHelp(EXIT_FAILURE);
+        }
+    }
+
+    // If every account is already up to date, no pages will be loaded at all, so stop warming up.
+    if ((warmingUp) && (!serving) && (isUpToDate(accounts, options))) {
+        warmup.cancel();
+        warmingUp = false;
+    }
+    if (warmingUp) {
+        options.warmup = &warmup;
+    }
+
+    // If we're a worker process, sync our shard of accounts, reporting back to the coordinator.
+    if (parser.isSet(workerOption)) {
+        Worker worker(parser.value(workerOption), accounts, options);
+        QObject::connect(&worker, &Worker::finished, &app, &QCoreApplication::exit,
+                         Qt::QueuedConnection);
+        QTimer::singleShot(0, &worker, &Worker::start);
+        const int result = app.exec();
+        if (warmingUp) {
+            RunSummary summary;
+            warmup.writeSummary(summary);
+            summary.log();
+        }
+        return result;
+    }
+
+    // If we're a server, sync accounts on request (sharing in-flight syncs), and/or on Fitbit
+    // notification (bypassing the fetch cache), until terminated.
+    if (serving) {
+        ControlServer server(accounts, options);
+        if ((parser.isSet(QStringLiteral("serve"))) &&
+            (!server.listen(parser.value(QStringLiteral("serve"))))) {
+            return EXIT_FAILURE;
+        }
+        QScopedPointer<WebhookReceiver> receiver;
+        if (parser.isSet(QStringLiteral("webhook"))) {
+            bool ok;
+            const quint16 port = parser.value(QStringLiteral("webhook")).toUShort(&ok);
+            if ((!ok) || (port == 0)) {
+                qCritical().noquote() << "Invalid webhook port:"
+                                      << parser.value(QStringLiteral("webhook"));
+                parser.showHelp(EXIT_FAILURE);
+            }
+            const QByteArray clientSecret = qgetenv("FITBIT_CLIENT_SECRET");
+            if (clientSecret.isEmpty()) {
+                qCritical() << "FITBIT_CLIENT_SECRET is required to verify notifications";
+                return EXIT_FAILURE;
+            }
+            receiver.reset(new WebhookReceiver(accounts, clientSecret,
+                QString::fromLocal8Bit(qgetenv("FITBIT_VERIFICATION_CODE"))));
+            QObject::connect(receiver.data(), &WebhookReceiver::syncRequested,
+                             &server, &ControlServer::requestSync);
+            if (!receiver->listen(port)) {
+                return EXIT_FAILURE;
+            }
+        }
+        return app.exec();
+    }
+
+    // If we have more than one account (or were asked to), shard them across worker processes.
+    if (coordinating) {
+        const int workers = parser.isSet(QStringLiteral("workers"))
+            ? parser.value(QStringLiteral("workers")).toInt() : 1;
+        if (workers < 1) {
+            qCritical().noquote() << "Invalid number of workers:"
+                                  << parser.value(QStringLiteral("workers"));
+            parser.showHelp(EXIT_FAILURE);
+        }
+        if (!parser.isSet(QStringLiteral("credentials"))) {
+            qCritical().noquote() << "Worker mode requires one or more credentials files";
+            parser.showHelp(EXIT_FAILURE);
         }
-    REQUIRE_SETTING(fitbitUser, Fitbit/username)
-    REQUIRE_SETTING(fitbitPass, Fitbit/password)
-    REQUIRE_SETTING(polarUser, Polar/username)
-    REQUIRE_SETTING(polarPass, Polar/password)
+        Coordinator coordinator(parser.values(QStringLiteral("credentials")), workers,
+                                workerArguments(parser));
+        coordinator.setMaxRestarts(parser.value(QStringLiteral("max-restarts")).toInt());
+        QObject::connect(&coordinator, &Coordinator::finished, &app, &QCoreApplication::exit,
+                         Qt::QueuedConnection);
+        QTimer::singleShot(0, &coordinator, &Coordinator::start);
+        const int result = app.exec();
+        coordinator.summary().log();
+        return result;
+    }
 
     // Do it.
-    Fitbit fitbit(fitbitUser, fitbitPass);
-    Polar polar(polarUser, polarPass);
-    QObject::connect(&fitbit,&Fitbit::weightFound,&polar,&Polar::setWeight);
-    fitbit.fetchWeight();
-    return app.exec();
+    SyncJob job(accounts.first(), options);
+    QObject::connect(&job, &SyncJob::finished, &app, &QCoreApplication::exit,
+                     Qt::QueuedConnection);
+    QTimer::singleShot(0, &job, &SyncJob::start);
+    const int result = app.exec();
+    RunSummary summary = job.summary();
+    if (warmingUp) {
+        warmup.writeSummary(summary);
+    }
+    summary.log();
+    return result;
+}
+
+/*!
+ * Returns \c true if all of the \a accounts are already up to date, so syncing them would not load
+ * any pages.
+ */
+bool isUpToDate(const QList<Account> &accounts, const SyncJob::Options &options)
+{
+    for (const Account &account: accounts) {
+        if (!SyncJob(account, options).isUpToDate()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ * Returns the name of the sync state file given by the command line \a parser (or the default).
+ * Or, if \a option is not empty, the file name given by that option, else the name of a file
+ * alongside the state file, with the state file's base name followed by \a suffix.
+ */
+QString stateFileName(const QCommandLineParser &parser, const QString &option,
+                      const QString &suffix)
+{
+    if ((!option.isEmpty()) && (parser.isSet(option))) {
+        return parser.value(option);
+    }
+    const QString fileName = parser.isSet(QStringLiteral("state"))
+        ? parser.value(QStringLiteral("state"))
+        : QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+          QStringLiteral("/state.ini");
+    if (option.isEmpty()) {
+        return fileName;
+    }
+    const QFileInfo info(fileName);
+    return info.absolutePath() + QLatin1Char('/') + info.completeBaseName() + suffix;
+}
+
+/*!
+ * Build the sync job options from the command line \a parser.
+ */
+SyncJob::Options syncOptions(QCommandLineParser &parser)
+{
+    SyncJob::Options options;
+
+    // Locate the persisted sync state.
+    options.stateFileName = stateFileName(parser);
+    if (!QDir().mkpath(QFileInfo(options.stateFileName).absolutePath())) {
+        qWarning() << "Failed to create directory for" << options.stateFileName;
+    }
+    qDebug() << "State file" << options.stateFileName;
+
+    // Journal pending writes, and record each sync's outcome, alongside the state file, unless
+    // told otherwise.
+    options.journalFileName =
+        stateFileName(parser, QStringLiteral("journal"), QStringLiteral(".journal.jsonl"));
+    qDebug() << "Journal file" << options.journalFileName;
+    options.historyFileName =
+        stateFileName(parser, QStringLiteral("history"), QStringLiteral(".history.jsonl"));
+    qDebug() << "History file" << options.historyFileName;
+
+    options.tolerance = parser.value(QStringLiteral("tolerance")).toDouble();
+    options.verifyAfterSecs =
+        parser.value(QStringLiteral("verify-after")).toLongLong() * 24 * 60 * 60;
+    options.fetchDaily = parser.isSet(QStringLiteral("fetch-daily"));
+    options.fetchTtlSecs = parser.value(QStringLiteral("fetch-ttl")).toLongLong() * 60;
+    if ((parser.isSet(QStringLiteral("fetch-window"))) &&
+        (!FetchCache::parseWindow(parser.value(QStringLiteral("fetch-window")),
+                                  options.fetchWindowStart, options.fetchWindowEnd))) {
+        qCritical().noquote() << "Invalid fetch window:"
+                              << parser.value(QStringLiteral("fetch-window"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    options.sampleInterval = qMax(parser.value(QStringLiteral("sample-interval")).toInt(), 100);
+    options.memoryLimit = parser.value(QStringLiteral("memory-limit")).toLongLong() * 1024 * 1024;
+    if ((parser.isSet(QStringLiteral("record"))) && (parser.isSet(QStringLiteral("replay")))) {
+        qCritical() << "Cannot both record and replay";
+        parser.showHelp(EXIT_FAILURE);
+    }
+    options.recordDir = parser.value(QStringLiteral("record"));
+    options.replayDir = parser.value(QStringLiteral("replay"));
+    options.replayLatency = parser.value(QStringLiteral("replay-latency")).toInt();
+    if (!Fitbit::parseExtraction(parser.value(QStringLiteral("extraction")), options.extraction)) {
+        qCritical().noquote() << "Invalid extraction mode:"
+                              << parser.value(QStringLiteral("extraction"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    options.extractionDataUrl.setPattern(parser.value(QStringLiteral("extraction-url")));
+    if (!options.extractionDataUrl.isValid()) {
+        qCritical().noquote() << "Invalid extraction URL pattern:"
+                              << options.extractionDataUrl.errorString();
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    // Budget each stage, and the sync overall, with defaults overridden by any --deadline options.
+    for (const StageTimer::Stage stage: {
+            StageTimer::Load, StageTimer::Login, StageTimer::Extract, StageTimer::Save }) {
+        options.stageBudgets.insert(stage, 60 * 1000);
+    }
+    options.overallBudget = 5 * 60 * 1000;
+    for (const QString &deadline: parser.values(QStringLiteral("deadline"))) {
+        const QString name = deadline.section(QLatin1Char('='), 0, 0);
+        bool ok = false;
+        const int secs = deadline.section(QLatin1Char('='), 1).toInt(&ok);
+        StageTimer::Stage stage = StageTimer::None;
+        if ((ok) && (secs >= 0) && (name == QLatin1String("overall"))) {
+            options.overallBudget = secs * 1000;
+        } else if ((ok) && (secs >= 0) && (StageTimer::parseStage(name, stage))) {
+            options.stageBudgets.insert(stage, secs * 1000);
+        } else {
+            qCritical().noquote() << "Invalid deadline:" << deadline;
+            parser.showHelp(EXIT_FAILURE);
+        }
+    }
+    options.retries = qMax(parser.value(QStringLiteral("retries")).toInt(), 0);
+    options.warmUp = !parser.isSet(QStringLiteral("no-warm-up"));
+
+    // Smooth, and screen, each account's measurements via its weight trend.
+    bool ok;
+    options.trend.alpha = parser.value(QStringLiteral("smoothing")).toDouble(&ok);
+    if ((!ok) || (options.trend.alpha <= 0.0) || (options.trend.alpha > 1.0)) {
+        qCritical().noquote() << "Invalid smoothing factor:"
+                              << parser.value(QStringLiteral("smoothing"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    options.trend.outlierSigmas = parser.value(QStringLiteral("outlier")).toDouble(&ok);
+    if ((!ok) || (options.trend.outlierSigmas <= 0.0)) {
+        qCritical().noquote() << "Invalid outlier sigmas:"
+                              << parser.value(QStringLiteral("outlier"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    options.trend.significance = parser.value(QStringLiteral("significance")).toDouble(&ok);
+    if ((!ok) || (options.trend.significance < 0.0)) {
+        qCritical().noquote() << "Invalid significance sigmas:"
+                              << parser.value(QStringLiteral("significance"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+    return options;
+}
+
+/*!
+ * Build the command line arguments to pass on to worker processes, based on the (coordinator's)
+ * command line \a parser. This excludes the credentials, which are sharded across the workers.
+ */
+QStringList workerArguments(const QCommandLineParser &parser)
+{
+    QStringList arguments;
+    for (const QString &name: {
+            QStringLiteral("debug"), QStringLiteral("fetch-daily"), QStringLiteral("no-color"),
+            QStringLiteral("no-warm-up"), QStringLiteral("show") }) {
+        if (parser.isSet(name)) {
+            arguments << QStringLiteral("--") + name;
+        }
+    }
+    for (const QString &name: {
+            QStringLiteral("extraction"), QStringLiteral("extraction-url"),
+            QStringLiteral("fetch-ttl"), QStringLiteral("fetch-window"), QStringLiteral("history"),
+            QStringLiteral("journal"), QStringLiteral("memory-limit"), QStringLiteral("outlier"),
+            QStringLiteral("record"), QStringLiteral("replay"), QStringLiteral("replay-latency"),
+            QStringLiteral("retries"), QStringLiteral("sample-interval"),
+            QStringLiteral("significance"), QStringLiteral("smoothing"), QStringLiteral("state"),
+            QStringLiteral("tolerance"), QStringLiteral("verify-after") }) {
+        if (parser.isSet(name)) {
+            arguments << QStringLiteral("--") + name << parser.value(name);
+        }
+    }
+    for (const QString &deadline: parser.values(QStringLiteral("deadline"))) {
+        arguments << QStringLiteral("--deadline") << deadline;
+    }
+    return arguments;
+}
+
+/*!
+ * Export the sync history (of the accounts named by any --account options) in the format, and to
+ * the file, given by the command line \a parser. The history is streamed through a buffered writer,
+ * so any amount of it is exported in constant memory.
+ */
+int exportHistory(QCommandLineParser &parser)
+{
+    ExportWriter::Format format;
+    if (!ExportWriter::parseFormat(parser.value(QStringLiteral("export")), format)) {
+        qCritical().noquote() << "Invalid export format:" << parser.value(QStringLiteral("export"));
+        parser.showHelp(EXIT_FAILURE);
+    }
+
+    QFile output;
+    const QString outputFileName = parser.value(QStringLiteral("output"));
+    if (outputFileName == QStringLiteral("-")) {
+        output.open(stdout, QIODevice::WriteOnly);
+    } else {
+        output.setFileName(outputFileName);
+        output.open(QIODevice::WriteOnly|QIODevice::Truncate);
+    }
+    if (!output.isOpen()) {
+        qCritical().noquote() << "Failed to open" << outputFileName << output.errorString();
+        return EXIT_FAILURE;
+    }
+
+    const QStringList accounts = parser.values(QStringLiteral("account"));
+    const SyncHistory history(
+        stateFileName(parser, QStringLiteral("history"), QStringLiteral(".history.jsonl")));
+    ExportWriter writer(&output, format);
+    const qint64 read = history.read([&accounts, &writer](const SyncHistory::Entry &entry) {
+        if ((!accounts.isEmpty()) && (!accounts.contains(entry.account)) &&
+            (!accounts.contains(QFileInfo(entry.account).completeBaseName()))) {
+            return true; // Not one of the requested accounts.
+        }
+        return writer.write(entry);
+    });
+    if ((read < 0) || (!writer.flush())) {
+        return EXIT_FAILURE;
+    }
+    qInfo().noquote() << "Exported" << writer.count() << "of" << read << "sync history entries";
+    return EXIT_SUCCESS;
 }
 
 /*!
@@ -0,0 +1,40 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef MEASUREMENT_H
+#define MEASUREMENT_H
+
+#include <QDateTime>
+#include <QMetaType>
+
+struct Measurement {
+    QDateTime date;
+    float weight;  // Kilograms.
+    float bodyFat; // Percent.
+    Measurement() : weight(0), bodyFat(0) { }
+
+    // Fitbit does not expose its own log IDs in the page, so the measurement's date serves as its
+    // (per account) identity.
+    QString id() const { return date.toString(Qt::ISODate); }
+    bool isValid() const { return ((date.isValid()) && (weight > 0)); }
+};
+
+Q_DECLARE_METATYPE(Measurement)
+
+#endif // MEASUREMENT_H
@@ -27,14 +27,17 @@
 #include "observablewebpage.h"
 
 ObservableWebPage::ObservableWebPage(QObject * parent) : NonInteractiveWebPage(parent),
-    observerVarName(QStringLiteral("observer_%1_").arg(QUuid::createUuid().toString(QUuid::Id128)))
+    observerVarName(QStringLiteral("observer_%1_").arg(QUuid::createUuid().toString(QUuid::Id128))),
+    channelVarName(QStringLiteral("channel_%1_").arg(QUuid::createUuid().toString(QUuid::Id128)))
 {
 
 }
 
 ObservableWebPage::ObservableWebPage(QWebEngineProfile * profile, QObject * parent)
     : NonInteractiveWebPage(profile, parent),
-      observerVarName(QStringLiteral("observer_%1_").arg(QUuid::createUuid().toString(QUuid::Id128)))
+      observerVarName(QStringLiteral("observer_%1_")
+                      .arg(QUuid::createUuid().toString(QUuid::Id128))),
+      channelVarName(QStringLiteral("channel_%1_").arg(QUuid::createUuid().toString(QUuid::Id128)))
 {
 
 }
@@ -44,6 +47,18 @@ ObservableWebPage::~ObservableWebPage()
 
 }
 
+/*!
+ * Returns the prefix that JavaScript console messages must begin with, to be emitted via the
+ * channelMessage signal for \a channel. The remainder of each message must be JSON text.
+ *
+ * For example: `console.debug(prefix + JSON.stringify(payload))`.
+ */
+QString ObservableWebPage::channelPrefix(const QString &channel) const
+{
+    Q_ASSERT(!channel.contains(QLatin1Char(':')));
+    return channelVarName + channel + QLatin1Char(':');
+}
+
 void ObservableWebPage::observe(const QString &target, const ObserveOptions &options)
 {
     QJsonObject optionsJson {
@@ -120,7 +135,7 @@ void ObservableWebPage::observeByClassName(const QString &className, const Obser
 
 void ObservableWebPage::observeByName(const QString &name, const ObserveOptions &options)
 {
-    observe(QStringLiteral("document.getElementsByClassName(%1)[0]").arg(name), options);
+    observe(QStringLiteral("document.getElementsByName(%1)[0]").arg(name), options);
 }
 
 void ObservableWebPage::observeBySelector(const QString &selector, const ObserveOptions &options)
@@ -162,5 +177,22 @@ void ObservableWebPage::javaScriptConsoleMessage(JavaScriptConsoleMessageLevel l
         return;
     }
 
+    if (message.startsWith(channelVarName)) {
+        const int colon = message.indexOf(QLatin1Char(':'), channelVarName.length());
+        const QString channel = message.mid(channelVarName.length(),
+                                            colon - channelVarName.length());
+        // Wrap the payload in an array, since QJsonDocument only parses objects and arrays.
+        QJsonParseError error;
+        const QJsonDocument payload = QJsonDocument::fromJson(
+            '[' + message.mid(colon + 1).toUtf8() + ']', &error);
+        if ((colon < 0) || (error.error != QJsonParseError::NoError)) {
+            qWarning().noquote() << "Failed to parse channel message from" << message;
+            qInfo() << error.errorString();
+            return;
+        }
+        emit channelMessage(channel, payload.array().first());
+        return;
+    }
+
     NonInteractiveWebPage::javaScriptConsoleMessage(level, message, lineNumber, sourceID);
 }
@@ -45,14 +45,19 @@ public:
     ObservableWebPage(QWebEngineProfile * profile, QObject * parent = Q_NULLPTR);
     ~ObservableWebPage() override;
 
+    // Prefix for JavaScript console messages to be emitted via the channelMessage signal.
+    QString channelPrefix(const QString &channel) const;
+
     void observe(const QString &target, const ObserveOptions &options);
     void observe(const QString &target, const QString &options);
 
     // Convenience methods that simply call the above observe methods.
-    void observeByClassName(const QString &className, const ObserveOptions &options = ObserveOptions());
+    void observeByClassName(const QString &className,
+                            const ObserveOptions &options = ObserveOptions());
     void observeById(const QString &Id, const ObserveOptions &options = ObserveOptions());
     void observeByName(const QString &name, const ObserveOptions &options = ObserveOptions());
-    void observeBySelector(const QString &selector, const ObserveOptions &options = ObserveOptions());
+    void observeBySelector(const QString &selector,
+                           const ObserveOptions &options = ObserveOptions());
     void observeByTagName(const QString &tagName, const ObserveOptions &options = ObserveOptions());
     void observeByTagNameNS(const QString &namespaceUri, const QString &localName,
                                    const ObserveOptions &options = ObserveOptions());
@@ -65,8 +70,10 @@ protected:
 
 private:
     const QString observerVarName;
+    const QString channelVarName;
 
 signals:
+    void channelMessage(const QString &channel, const QJsonValue &payload);
     void mutationObserved(const QJsonObject &mutation);
 
 };
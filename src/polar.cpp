@@ -17,31 +17,43 @@
     along with Float.  If not, see <https://www.gnu.org/licenses/>.
 */
 
-#include <QCoreApplication>
 #include <QDebug>
+#include <QPointer>
 #include <QWebEngineProfile>
 #include <QWebEngineScript>
 
+#include "exitcode.h"
 #include "polar.h"
 #include "noninteractivewebpage.h"
 
+#define FLOW_ORIGIN QStringLiteral("https://flow.polar.com")
 #define FLOW_SETTINGS_URL QStringLiteral("https://flow.polar.com/settings")
 
-Polar::Polar(const QString &username, const QString &password, QObject * parent)
-    :  QObject(parent), username(username), password(password)
-{
-    // Create a new web page, with an 'anonymous' profile (unshared, in-memory cookies, etc).
-    page = new NonInteractiveWebPage(new QWebEngineProfile, this);
-    page->profile()->setParent(this); // Done post-construction to ensure deletion *after* page.
-    Q_ASSERT(page->profile()->isOffTheRecord());
-
+/*!
+ * Construct a Polar Flow session for \a username and \a password, using \a profile (which must be
+ * off-the-record, and outlive this object), or else a new profile of its own.
+ */
+Polar::Polar(const QString &username, const QString &password, QWebEngineProfile * profile,
+             QObject * parent)
+    :  QObject(parent), profile(profile), page(Q_NULLPTR),
 #ifdef USE_WEB_ENGINE_VIEW
-    // Create a web engine view (if we're using one), and assign our custom web page.
-    view = new QWebEngineView();
-    view->setPage(page);
+       view(Q_NULLPTR),
 #endif
+       username(username), password(password), mass(0), record(QString(), username),
+       tolerance(0.0), verifyAfterSecs(0), retries(0), maxRetries(0)
+{
+    // Unless given one (eg, already warmed up), create an 'anonymous' profile (unshared, in-memory
+    // cookies, etc). The profile outlives any pages we create (and recreate) with it, so the login
+    // session survives page recreation.
+    if (!this->profile) {
+        this->profile = new QWebEngineProfile(this);
+    }
+    Q_ASSERT(this->profile->isOffTheRecord());
 
-    connect(page, &NonInteractiveWebPage::loadFinished, this, &Polar::onLoadFinshed);
+    stages = new StageTimer(this);
+    connect(stages, &StageTimer::expired, this, &Polar::onStageExpired);
+
+    createPage();
 }
 
 Polar::~Polar()
@@ -49,33 +61,126 @@ Polar::~Polar()
 #ifdef USE_WEB_ENGINE_VIEW
     delete view;
 #endif
-    delete page;
+    // Delete all pages (including any retired ones) explicitly, to ensure their deletion *before*
+    // the profile's.
+    qDeleteAll(findChildren<NonInteractiveWebPage *>(QString(), Qt::FindDirectChildrenOnly));
+}
+
+QWebEnginePage * Polar::webPage() const
+{
+    return page;
+}
+
+/*!
+ * Persist the last successfully written weight in (and load it from) the \a fileName state file,
+ * so that unchanged weights can be skipped without starting a browser session at all.
+ */
+void Polar::setStateFile(const QString &fileName)
+{
+    record = WriteRecord(fileName, QStringLiteral("Polar/%1").arg(username));
+}
+
+/*!
+ * Treat weights within \a tolerance kilograms of the last written weight as unchanged.
+ */
+void Polar::setTolerance(const double tolerance)
+{
+    this->tolerance = tolerance;
+}
+
+/*!
+ * Re-verify unchanged weights against Polar Flow anyway, if the last write is older than \a secs.
+ */
+void Polar::setVerifyAfter(const qint64 secs)
+{
+    verifyAfterSecs = secs;
+}
+
+/*!
+ * Returns the origin of the Polar Flow web app.
+ */
+QUrl Polar::origin()
+{
+    return QUrl(FLOW_ORIGIN);
+}
+
+/*!
+ * Recreate the page, and start over, up to \a count times if a stage exceeds its budget, or the
+ * renderer process crashes.
+ */
+void Polar::setMaxRetries(const int count)
+{
+    maxRetries = count;
+}
+
+/*!
+ * Set the wall-clock budget, in milliseconds, of each stage of setting the weight.
+ */
+void Polar::setStageBudgets(const QMap<StageTimer::Stage, int> &msecs)
+{
+    stages->setBudgets(msecs);
 }
 
 // Public Slots
 
-void Polar::setWeight(const double mass)
+/*!
+ * Hint the web engine to resolve, and connect to, Polar Flow ahead of time, while the page would
+ * otherwise sit idle (eg while the weight is still being fetched from Fitbit).
+ */
+void Polar::preconnect()
+{
+    page->setHtml(QStringLiteral("<link rel=\"dns-prefetch\" href=\"%1\">"
+                                 "<link rel=\"preconnect\" href=\"%1\">")
+                  .arg(origin().toString()),
+                  QUrl(QStringLiteral("about:blank")));
+}
+
+void Polar::setWeight(const double mass, const QString &sourceId)
 {
     qDebug() << "Setting weight to" << mass << "kg";
+    this->mass = mass;
+    this->sourceId = sourceId;
 
-    // Sanity check my weight range (yes, this is just for me ;)
-    if ((60 >= mass) || (mass >= 90)) {
-        qWarning() << "Invalid mass:" << mass;
-        QCoreApplication::exit(EXIT_FAILURE);
+    // Skip the browser session entirely if we've already written this weight recently.
+    if (record.isCurrent(mass, tolerance, verifyAfterSecs)) {
+        qInfo().noquote() << QStringLiteral("Weight is already %1 (written %2 from %3)")
+            .arg(record.mass()).arg(record.timestamp().toLocalTime().toString(Qt::ISODate),
+                                     record.sourceId());
+        emit weightSet(record.mass(), false);
         return;
     }
-    this->mass = mass;
+    load();
+}
+
+// Protected Methods
 
+/*!
+ * Create (or recreate) the web page, and its view (if using one).
+ */
+void Polar::createPage()
+{
+    if (page) {
+        // We may be here via one of the old page's signals, so don't delete it just yet.
+        page->disconnect(this);
 #ifdef USE_WEB_ENGINE_VIEW
-    Q_ASSERT(view);
-    view->load(FLOW_SETTINGS_URL);
-    view->show();
-#else
-    page->load(FLOW_SETTINGS_URL);
+        view->deleteLater();
 #endif
-}
+        page->deleteLater();
+    }
 
-// Protected Methods
+    page = new NonInteractiveWebPage(profile, this);
+
+#ifdef USE_WEB_ENGINE_VIEW
+    // Create a web engine view (if we're using one), and assign our custom web page.
+    view = new QWebEngineView();
+    view->setPage(page);
+#endif
+
+    connect(page, &NonInteractiveWebPage::loadFinished, this, &Polar::onLoadFinshed);
+    connect(page, &NonInteractiveWebPage::renderProcessTerminated,
+            this, &Polar::onRenderProcessTerminated);
+    emit pageChanged(page);
+}
 
 QString Polar::javaScriptLiteral(QString string, QChar quote)
 {
@@ -99,12 +204,50 @@ QString Polar::javaScriptLiteral(QString string, QChar quote)
         + quote;
 }
 
+/*!
+ * Load the Polar Flow settings page, to begin setting the weight.
+ */
+void Polar::load()
+{
+    stages->start(StageTimer::Load);
+#ifdef USE_WEB_ENGINE_VIEW
+    Q_ASSERT(view);
+    view->load(FLOW_SETTINGS_URL);
+    view->show();
+#else
+    page->load(FLOW_SETTINGS_URL);
+#endif
+}
+
+/*!
+ * Recreate the page and start over, unless we've already retried too many times, in which case
+ * fail with \a reason and \a exitCode.
+ */
+void Polar::retry(const QString &reason, const int exitCode)
+{
+    if (retries >= maxRetries) {
+        stages->stop();
+        emit failed(reason, exitCode);
+        return;
+    }
+    ++retries;
+    qWarning().noquote() << reason << QStringLiteral("; retrying (%1 of %2)")
+                                      .arg(retries).arg(maxRetries);
+    createPage();
+    load();
+}
+
 // Protected Slots
 
 void Polar::onLoadFinshed(const bool ok)
 {
     qDebug() << "Finished loading" << page->url().toString() << ok;
 
+    // Nothing to do until we have a weight to set (eg, if only preconnecting so far).
+    if (mass <= 0) {
+        return;
+    }
+
     // Check the webpage was loaded successfully.
     if (!ok) {
         qWarning() << "Failed to load" << page->url().toString();
@@ -112,6 +255,7 @@ void Polar::onLoadFinshed(const bool ok)
     }
 
     // Login and/or update the weight.
+    const QPointer<NonInteractiveWebPage> source(page);
     page->runJavaScript(
         QStringLiteral(R"JS(
             function nextStep() {
@@ -136,6 +280,7 @@ void Polar::onLoadFinshed(const bool ok)
                     console.info(`QtInfoMsg: Updating weight from ${weight.value} to %3`);
                     weight.value = %3;
                     document.getElementById('save-account-btn').click();
+                    return 'saved'; // Keep running.
                 }
             }
             try {
@@ -146,22 +291,50 @@ void Polar::onLoadFinshed(const bool ok)
                result;
             }
         )JS").arg(javaScriptLiteral(username), javaScriptLiteral(password)).arg(mass),
-        QWebEngineScript::ApplicationWorld, [](const QVariant &result) {
+        QWebEngineScript::ApplicationWorld, [this, source](const QVariant &result) {
             qDebug() << "JavaScript result" << result;
+            if (source != page) {
+                return; // The page has since been recreated.
+            }
 
             // Stop on errors.
             const QVariantMap error = result.toMap().value(QStringLiteral("error")).toMap();
             if (!error.isEmpty()) {
                 qCritical().noquote() << error.value(QLatin1String("name")).toString()
                                       << error.value(QLatin1String("message")).toString();
-                QCoreApplication::exit(EXIT_FAILURE);
+                stages->stop();
+                emit failed(error.value(QLatin1String("message")).toString(), ExitCode::Failure);
                 return;
             }
 
-            // Stop on 'false'.
-            if ((result.type() == QVariant::Bool) && (!result.toBool())) {
-                QCoreApplication::exit(EXIT_SUCCESS); // We're done :)
+            // Note the stage we're in now, or stop on 'false'.
+            if (result.type() == QVariant::Bool) {
+                if (result.toBool()) {
+                    stages->start(StageTimer::Login);
+                } else {
+                    stages->stop();
+                    record.save(mass, sourceId);
+                    emit weightSet(mass, true); // We're done :)
+                }
+            } else if (result.toString() == QLatin1String("saved")) {
+                stages->start(StageTimer::Save);
             }
         }
     );
 }
+
+void Polar::onRenderProcessTerminated(
+    const QWebEnginePage::RenderProcessTerminationStatus status, const int exitCode)
+{
+    if (status == QWebEnginePage::NormalTerminationStatus) {
+        return;
+    }
+    retry(QStringLiteral("Polar renderer process terminated abnormally (status %1, exit code %2)")
+          .arg(status).arg(exitCode), ExitCode::RendererCrashed);
+}
+
+void Polar::onStageExpired(const StageTimer::Stage stage)
+{
+    retry(QStringLiteral("Polar %1 stage timed out").arg(StageTimer::stageName(stage)),
+          StageTimer::exitCode(stage));
+}
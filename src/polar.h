@@ -27,32 +27,68 @@
 #include <QWebEngineView>
 #endif
 
+#include "stagetimer.h"
+#include "writerecord.h"
+
 class NonInteractiveWebPage;
+class QWebEngineProfile;
 
 class Polar : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit Polar(const QString &username, const QString &password, QObject * parent = Q_NULLPTR);
+    explicit Polar(const QString &username, const QString &password,
+                   QWebEngineProfile * profile = Q_NULLPTR, QObject * parent = Q_NULLPTR);
     virtual ~Polar();
 
+    QWebEnginePage * webPage() const;
+
+    void setStateFile(const QString &fileName);
+    void setTolerance(const double tolerance);
+    void setVerifyAfter(const qint64 secs);
+
+    static QUrl origin();
+
+    void setMaxRetries(const int count);
+    void setStageBudgets(const QMap<StageTimer::Stage, int> &msecs);
+
 public slots:
-    void setWeight(const double mass);
+    void preconnect();
+    void setWeight(const double mass, const QString &sourceId = QString());
 
 protected:
+    void createPage();
     static QString javaScriptLiteral(QString string, QChar quote = QChar());
+    void load();
+    void retry(const QString &reason, const int exitCode);
 
 protected slots:
     void onLoadFinshed(const bool ok);
+    void onRenderProcessTerminated(const QWebEnginePage::RenderProcessTerminationStatus status,
+                                   const int exitCode);
+    void onStageExpired(const StageTimer::Stage stage);
 
 private:
+    QWebEngineProfile * profile;
     NonInteractiveWebPage * page;
+    StageTimer * stages;
 #ifdef USE_WEB_ENGINE_VIEW
     QWebEngineView * view;
 #endif
     QString username;
     QString password;
     double mass;
+    QString sourceId;
+    WriteRecord record;
+    double tolerance;
+    qint64 verifyAfterSecs;
+    int retries;
+    int maxRetries;
+
+signals:
+    void failed(const QString &reason, const int exitCode);
+    void pageChanged(QWebEnginePage * page);
+    void weightSet(const double mass, const bool written);
 
 };
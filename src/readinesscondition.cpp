@@ -0,0 +1,113 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QRegularExpression>
+
+#include "readinesscondition.h"
+
+/*!
+ * Construct a pending condition of \a type, which will expire if not satisfied within
+ * \a deadlineMsecs (if positive). Conditions delete themselves once satisfied, expired or
+ * cancelled.
+ */
+ReadinessCondition::ReadinessCondition(const Type type, const QVariant &argument,
+                                       const int deadlineMsecs, QObject * parent)
+    : QObject(parent), conditionType(type), conditionArgument(argument), pending(true)
+{
+    timer.start();
+    if (deadlineMsecs > 0) {
+        deadline.setSingleShot(true);
+        connect(&deadline, &QTimer::timeout, this, &ReadinessCondition::expire);
+        deadline.start(deadlineMsecs);
+    }
+}
+
+ReadinessCondition::~ReadinessCondition()
+{
+
+}
+
+QVariant ReadinessCondition::argument() const
+{
+    return conditionArgument;
+}
+
+QString ReadinessCondition::description() const
+{
+    switch (conditionType) {
+    case Type::NetworkIdle:
+        return QStringLiteral("network idle for %1ms").arg(conditionArgument.toInt());
+    case Type::Response:
+        return QStringLiteral("response matching %1")
+            .arg(conditionArgument.toRegularExpression().pattern());
+    case Type::Selector:
+        return QStringLiteral("selector %1").arg(conditionArgument.toString());
+    }
+    return QString();
+}
+
+qint64 ReadinessCondition::elapsed() const
+{
+    return timer.elapsed();
+}
+
+bool ReadinessCondition::isPending() const
+{
+    return pending;
+}
+
+ReadinessCondition::Type ReadinessCondition::type() const
+{
+    return conditionType;
+}
+
+// Public Slots
+
+void ReadinessCondition::cancel()
+{
+    if (pending) {
+        pending = false;
+        deadline.stop();
+        deleteLater();
+    }
+}
+
+void ReadinessCondition::satisfy()
+{
+    if (pending) {
+        qDebug().noquote() << "Ready:" << description() << "after" << elapsed() << "ms";
+        pending = false;
+        deadline.stop();
+        emit met();
+        deleteLater();
+    }
+}
+
+// Protected Slots
+
+void ReadinessCondition::expire()
+{
+    if (pending) {
+        qWarning().noquote() << "Timed out waiting for" << description();
+        pending = false;
+        emit expired();
+        deleteLater();
+    }
+}
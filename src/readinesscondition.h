@@ -0,0 +1,69 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef READINESSCONDITION_H
+#define READINESSCONDITION_H
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QTimer>
+#include <QVariant>
+
+class ReadinessCondition : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum class Type {
+        NetworkIdle, // Argument is the required quiet period, in milliseconds.
+        Response,    // Argument is a QRegularExpression to match response URLs against.
+        Selector,    // Argument is a CSS selector string.
+    };
+
+    ReadinessCondition(const Type type, const QVariant &argument, const int deadlineMsecs,
+                       QObject * parent = Q_NULLPTR);
+    virtual ~ReadinessCondition();
+
+    QVariant argument() const;
+    QString description() const;
+    qint64 elapsed() const;
+    bool isPending() const;
+    Type type() const;
+
+public slots:
+    void cancel();
+    void satisfy();
+
+protected slots:
+    void expire();
+
+private:
+    const Type conditionType;
+    const QVariant conditionArgument;
+    QTimer deadline;
+    QElapsedTimer timer;
+    bool pending;
+
+signals:
+    void expired();
+    void met();
+
+};
+
+#endif // READINESSCONDITION_H
@@ -0,0 +1,274 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QWebEngineScript>
+#include <QWebEngineScriptCollection>
+
+#include <algorithm>
+
+#include "observablewebpage.h"
+#include "readinessmonitor.h"
+
+#define READINESS_CHANNEL_RESOURCES QStringLiteral("resources")
+#define READINESS_CHANNEL_SELECTOR QStringLiteral("selector")
+
+// Requests that never report completion (eg because they were blocked, or failed before sending a
+// response) are no longer considered in flight after this long.
+#define STALE_REQUEST_MSECS 10000
+
+/*!
+ * Construct a readiness monitor for \a page, which tracks the page's in-flight requests via a page
+ * request interceptor (for request starts) and a PerformanceObserver (for request completions).
+ */
+ReadinessMonitor::ReadinessMonitor(ObservableWebPage * page)
+    : QWebEngineUrlRequestInterceptor(page), page(page), lastActivity(0), nextId(0)
+{
+    clock.start();
+    idleTimer.setInterval(100);
+    connect(&idleTimer, &QTimer::timeout, this, &ReadinessMonitor::checkNetworkIdle);
+
+    page->setUrlRequestInterceptor(this);
+    connect(page, &ObservableWebPage::channelMessage, this, &ReadinessMonitor::onChannelMessage);
+    connect(page, &ObservableWebPage::loadFinished, this, &ReadinessMonitor::onLoadFinished);
+    connect(page, &ObservableWebPage::loadStarted, this, &ReadinessMonitor::onLoadStarted);
+
+    // Report each completed resource (including fetch and XHR requests) as soon as it completes.
+    QWebEngineScript script;
+    script.setName(QStringLiteral("readinessMonitor"));
+    script.setInjectionPoint(QWebEngineScript::DocumentCreation);
+    script.setWorldId(QWebEngineScript::ApplicationWorld);
+    script.setRunsOnSubFrames(false);
+    script.setSourceCode(QStringLiteral(R"JS(
+        if (typeof PerformanceObserver !== 'undefined') {
+            new PerformanceObserver(function (list) {
+                console.debug('%1' + JSON.stringify(list.getEntries().map((entry) => entry.name)));
+            }).observe({ entryTypes: ['resource'] });
+        }
+    )JS").arg(page->channelPrefix(READINESS_CHANNEL_RESOURCES)));
+    page->scripts().insert(script);
+}
+
+ReadinessMonitor::~ReadinessMonitor()
+{
+
+}
+
+/*!
+ * Returns the number of (non-navigation) requests currently in flight.
+ */
+int ReadinessMonitor::inFlight() const
+{
+    int count = 0;
+    const qint64 staleBefore = clock.elapsed() - STALE_REQUEST_MSECS;
+    for (const QList<qint64> &starts: requests) {
+        for (const qint64 start: starts) {
+            if (start >= staleBefore) {
+                ++count;
+            }
+        }
+    }
+    return count;
+}
+
+/*!
+ * Returns a condition that is met once no requests have been in flight for \a quietMsecs.
+ */
+ReadinessCondition * ReadinessMonitor::waitForNetworkIdle(const int quietMsecs,
+                                                          const int deadlineMsecs)
+{
+    ReadinessCondition * const condition =
+        addCondition(ReadinessCondition::Type::NetworkIdle, quietMsecs, deadlineMsecs);
+    idleTimer.start();
+    return condition;
+}
+
+/*!
+ * Returns a condition that is met once a request whose URL matches \a url has completed.
+ */
+ReadinessCondition * ReadinessMonitor::waitForResponse(const QRegularExpression &url,
+                                                       const int deadlineMsecs)
+{
+    return addCondition(ReadinessCondition::Type::Response, url, deadlineMsecs);
+}
+
+/*!
+ * Returns a condition that is met once the current document contains an element matching the CSS
+ * \a selector. If the page navigates before then, the condition carries over to the new document.
+ */
+ReadinessCondition * ReadinessMonitor::waitForSelector(const QString &selector,
+                                                       const int deadlineMsecs)
+{
+    ReadinessCondition * const condition =
+        addCondition(ReadinessCondition::Type::Selector, selector, deadlineMsecs);
+    armSelector(conditions.key(condition), selector);
+    return condition;
+}
+
+void ReadinessMonitor::interceptRequest(QWebEngineUrlRequestInfo &info)
+{
+    // Navigations are covered by the page's own load signals, and don't get performance entries.
+    if ((info.resourceType() == QWebEngineUrlRequestInfo::ResourceTypeMainFrame) ||
+        (info.resourceType() == QWebEngineUrlRequestInfo::ResourceTypeSubFrame)) {
+        return;
+    }
+    lastActivity = clock.elapsed();
+    requests[normalised(info.requestUrl())].append(lastActivity);
+}
+
+// Public Slots
+
+void ReadinessMonitor::cancelAll()
+{
+    for (const QPointer<ReadinessCondition> &condition: conditions) {
+        if (condition) {
+            condition->cancel();
+        }
+    }
+    conditions.clear();
+}
+
+// Protected Methods
+
+ReadinessCondition * ReadinessMonitor::addCondition(const ReadinessCondition::Type type,
+                                                    const QVariant &argument,
+                                                    const int deadlineMsecs)
+{
+    ReadinessCondition * const condition =
+        new ReadinessCondition(type, argument, deadlineMsecs, this);
+    const int id = nextId++;
+    conditions.insert(id, condition);
+    connect(condition, &QObject::destroyed, this, [this, id]() { conditions.remove(id); });
+    return condition;
+}
+
+void ReadinessMonitor::armSelector(const int id, const QString &selector)
+{
+    // Check for the selector now, and then again whenever the document changes, until found.
+    const QString script = QStringLiteral(R"JS(
+        (function (id, selector) {
+            const report = () => console.debug('%1' + JSON.stringify(id));
+            if (document.querySelector(selector)) {
+                report();
+                return;
+            }
+            const observer = new MutationObserver(function () {
+                if (document.querySelector(selector)) {
+                    observer.disconnect();
+                    report();
+                }
+            });
+            observer.observe(document, { attributes: true, childList: true, subtree: true });
+        })(%2, %3);
+    )JS").arg(page->channelPrefix(READINESS_CHANNEL_SELECTOR)).arg(id)
+         .arg(QString::fromUtf8(QJsonDocument(QJsonArray{selector}).toJson(QJsonDocument::Compact))
+              .mid(1).chopped(1));
+    page->runJavaScript(script, QWebEngineScript::ApplicationWorld);
+}
+
+QString ReadinessMonitor::normalised(const QUrl &url)
+{
+    return url.adjusted(QUrl::RemoveFragment).toString(QUrl::FullyEncoded);
+}
+
+// Protected Slots
+
+void ReadinessMonitor::checkNetworkIdle()
+{
+    // Drop stale requests, so they can't hold up network idle conditions indefinitely.
+    const qint64 now = clock.elapsed();
+    for (auto iter = requests.begin(); iter != requests.end();) {
+        QList<qint64> &starts = iter.value();
+        starts.erase(std::remove_if(starts.begin(), starts.end(), [now](const qint64 start) {
+            return (now - start) > STALE_REQUEST_MSECS;
+        }), starts.end());
+        iter = (starts.isEmpty()) ? requests.erase(iter) : (iter + 1);
+    }
+
+    bool waiting = false;
+    for (const QPointer<ReadinessCondition> &condition: conditions.values()) {
+        if ((condition) && (condition->isPending()) &&
+            (condition->type() == ReadinessCondition::Type::NetworkIdle)) {
+            if ((requests.isEmpty()) && ((now - lastActivity) >= condition->argument().toInt())) {
+                condition->satisfy();
+            } else {
+                waiting = true;
+            }
+        }
+    }
+    if (!waiting) {
+        idleTimer.stop();
+    }
+}
+
+void ReadinessMonitor::onChannelMessage(const QString &channel, const QJsonValue &payload)
+{
+    if (channel == READINESS_CHANNEL_SELECTOR) {
+        const QPointer<ReadinessCondition> condition = conditions.value(payload.toInt());
+        if (condition) {
+            condition->satisfy();
+        }
+        return;
+    }
+
+    if (channel != READINESS_CHANNEL_RESOURCES) {
+        return;
+    }
+    lastActivity = clock.elapsed();
+    for (const QJsonValue &name: payload.toArray()) {
+        const QString url = normalised(QUrl(name.toString()));
+        auto iter = requests.find(url);
+        if (iter != requests.end()) {
+            iter.value().removeFirst();
+            if (iter.value().isEmpty()) {
+                requests.erase(iter);
+            }
+        }
+        for (const QPointer<ReadinessCondition> &condition: conditions.values()) {
+            if ((condition) && (condition->isPending()) &&
+                (condition->type() == ReadinessCondition::Type::Response) &&
+                (condition->argument().toRegularExpression().match(url).hasMatch())) {
+                condition->satisfy();
+            }
+        }
+    }
+}
+
+void ReadinessMonitor::onLoadFinished(const bool ok)
+{
+    if (!ok) {
+        return;
+    }
+    // Re-arm any pending selector conditions in the newly loaded document.
+    for (auto iter = conditions.constBegin(); iter != conditions.constEnd(); ++iter) {
+        if ((iter.value()) && (iter.value()->isPending()) &&
+            (iter.value()->type() == ReadinessCondition::Type::Selector)) {
+            armSelector(iter.key(), iter.value()->argument().toString());
+        }
+    }
+}
+
+void ReadinessMonitor::onLoadStarted()
+{
+    // The previous document's requests will never complete (as far as we can observe).
+    requests.clear();
+    lastActivity = clock.elapsed();
+}
@@ -0,0 +1,78 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef READINESSMONITOR_H
+#define READINESSMONITOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonValue>
+#include <QList>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QWebEngineUrlRequestInterceptor>
+
+#include "readinesscondition.h"
+
+class ObservableWebPage;
+
+class ReadinessMonitor : public QWebEngineUrlRequestInterceptor
+{
+    Q_OBJECT
+
+public:
+    explicit ReadinessMonitor(ObservableWebPage * page);
+    ~ReadinessMonitor() override;
+
+    int inFlight() const;
+
+    ReadinessCondition * waitForNetworkIdle(const int quietMsecs, const int deadlineMsecs);
+    ReadinessCondition * waitForResponse(const QRegularExpression &url, const int deadlineMsecs);
+    ReadinessCondition * waitForSelector(const QString &selector, const int deadlineMsecs);
+
+    void interceptRequest(QWebEngineUrlRequestInfo &info) override;
+
+public slots:
+    void cancelAll();
+
+protected:
+    ReadinessCondition * addCondition(const ReadinessCondition::Type type,
+                                      const QVariant &argument, const int deadlineMsecs);
+    void armSelector(const int id, const QString &selector);
+    static QString normalised(const QUrl &url);
+
+protected slots:
+    void checkNetworkIdle();
+    void onChannelMessage(const QString &channel, const QJsonValue &payload);
+    void onLoadFinished(const bool ok);
+    void onLoadStarted();
+
+private:
+    ObservableWebPage * page;
+    QElapsedTimer clock;
+    qint64 lastActivity;
+    QHash<QString, QList<qint64>> requests; // Normalised URL -> request start times.
+    QTimer idleTimer;
+    QHash<int, QPointer<ReadinessCondition>> conditions;
+    int nextId;
+
+};
+
+#endif // READINESSMONITOR_H
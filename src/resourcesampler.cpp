@@ -0,0 +1,194 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QSet>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#include "resourcesampler.h"
+#include "runsummary.h"
+
+#define BROWSER_PROCESS_NAME QStringLiteral("browser")
+
+ResourceSampler::ResourceSampler(QObject * parent)
+    : QObject(parent), phase(QStringLiteral("startup")), memoryLimit(0), limitExceeded(false)
+{
+    phases.append(phase);
+    timer.setInterval(1000);
+    connect(&timer, &QTimer::timeout, this, &ResourceSampler::sample);
+}
+
+ResourceSampler::~ResourceSampler()
+{
+
+}
+
+void ResourceSampler::addPage(const QString &name, QWebEnginePage * page)
+{
+    pages.insert(name, page);
+}
+
+void ResourceSampler::setInterval(const int msecs)
+{
+    timer.setInterval(msecs);
+}
+
+void ResourceSampler::setMemoryLimit(const qint64 bytes)
+{
+    memoryLimit = bytes;
+}
+
+void ResourceSampler::writeSummary(RunSummary &summary) const
+{
+    for (const QString &phaseName: phases) {
+        const QMap<QString, Stats> processes = stats.value(phaseName);
+        for (auto iter = processes.constBegin(); iter != processes.constEnd(); ++iter) {
+            const Stats &process = iter.value();
+            if (process.count == 0) {
+                continue;
+            }
+            QVariantMap values;
+            values.insert(QStringLiteral("peakRssKiB"), process.peakRssBytes / 1024);
+            values.insert(QStringLiteral("averageRssKiB"),
+                          process.totalRssBytes / process.count / 1024);
+            values.insert(QStringLiteral("cpuMsecs"), process.lastCpuMsecs - process.firstCpuMsecs);
+            values.insert(QStringLiteral("samples"), process.count);
+            summary.insert(QStringLiteral("resources.%1.%2").arg(phaseName, iter.key()), values);
+        }
+    }
+}
+
+/*!
+ * Read the resident set size, and total (user plus system) CPU time of process \a pid.
+ *
+ * This is currently only implemented for Linux, via the `/proc/<pid>/status` and
+ * `/proc/<pid>/stat` files. On other platforms, the returned sample is always invalid.
+ */
+ResourceSampler::Sample ResourceSampler::sampleProcess(const qint64 pid)
+{
+    Sample sample;
+#ifdef Q_OS_LINUX
+    QFile status(QStringLiteral("/proc/%1/status").arg(pid));
+    if (!status.open(QIODevice::ReadOnly)) {
+        return sample;
+    }
+    // Looks like: "VmRSS:\t   81232 kB".
+    for (QByteArray line = status.readLine(); !line.isEmpty(); line = status.readLine()) {
+        if (line.startsWith("VmRSS:")) {
+            sample.rssBytes = line.mid(6).simplified().split(' ').first().toLongLong() * 1024;
+            break;
+        }
+    }
+
+    QFile stat(QStringLiteral("/proc/%1/stat").arg(pid));
+    if (!stat.open(QIODevice::ReadOnly)) {
+        return sample;
+    }
+    // The second field (comm) may contain spaces, so skip past its closing parenthesis. After
+    // that, utime and stime are the 12th and 13th fields (ie fields 14 and 15 of proc(5)).
+    const QByteArray line = stat.readAll();
+    const QList<QByteArray> fields = line.mid(line.lastIndexOf(')') + 2).split(' ');
+    if (fields.size() < 13) {
+        return sample;
+    }
+    static const long ticksPerSecond = sysconf(_SC_CLK_TCK);
+    sample.cpuMsecs = (fields.at(11).toLongLong() + fields.at(12).toLongLong()) * 1000
+                      / ((ticksPerSecond > 0) ? ticksPerSecond : 100);
+    sample.isValid = true;
+#else
+    Q_UNUSED(pid)
+#endif
+    return sample;
+}
+
+// Public Slots
+
+void ResourceSampler::setPhase(const QString &phase)
+{
+    if (phase == this->phase) {
+        return;
+    }
+    qDebug() << "Resource sampling phase" << phase;
+    sample(); // Close out the previous phase.
+    this->phase = phase;
+    if (!phases.contains(phase)) {
+        phases.append(phase);
+    }
+    sample(); // Establish a baseline for the new phase.
+}
+
+void ResourceSampler::start()
+{
+    sample();
+    timer.start();
+}
+
+void ResourceSampler::stop()
+{
+    timer.stop();
+    sample();
+}
+
+// Protected Slots
+
+void ResourceSampler::sample()
+{
+    // Collect the processes to sample; several pages may share a single renderer process.
+    QMap<QString, qint64> pids;
+    pids.insert(BROWSER_PROCESS_NAME, QCoreApplication::applicationPid());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    for (auto iter = pages.constBegin(); iter != pages.constEnd(); ++iter) {
+        if ((iter.value()) && (iter.value()->renderProcessPid() > 0)) {
+            pids.insert(iter.key(), iter.value()->renderProcessPid());
+        }
+    }
+#endif
+
+    QSet<qint64> countedPids;
+    qint64 totalRssBytes = 0;
+    for (auto iter = pids.constBegin(); iter != pids.constEnd(); ++iter) {
+        const Sample current = sampleProcess(iter.value());
+        if (!current.isValid) {
+            continue;
+        }
+        Stats &process = stats[phase][iter.key()];
+        if (process.count == 0) {
+            process.firstCpuMsecs = current.cpuMsecs;
+        }
+        process.peakRssBytes = qMax(process.peakRssBytes, current.rssBytes);
+        process.totalRssBytes += current.rssBytes;
+        process.lastCpuMsecs = current.cpuMsecs;
+        ++process.count;
+        if (!countedPids.contains(iter.value())) {
+            countedPids.insert(iter.value());
+            totalRssBytes += current.rssBytes;
+        }
+    }
+
+    if ((memoryLimit > 0) && (totalRssBytes > memoryLimit) && (!limitExceeded)) {
+        limitExceeded = true; // Only report once; the receiver is expected to abort.
+        qWarning() << "Memory usage" << totalRssBytes << "exceeds limit" << memoryLimit;
+        emit memoryLimitExceeded(totalRssBytes, memoryLimit);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RESOURCESAMPLER_H
+#define RESOURCESAMPLER_H
+
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QTimer>
+#include <QWebEnginePage>
+
+class RunSummary;
+
+class ResourceSampler : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Sample {
+        qint64 rssBytes;
+        qint64 cpuMsecs;
+        bool isValid;
+        Sample() : rssBytes(0), cpuMsecs(0), isValid(false) { }
+    };
+
+    explicit ResourceSampler(QObject * parent = Q_NULLPTR);
+    virtual ~ResourceSampler();
+
+    void addPage(const QString &name, QWebEnginePage * page);
+    void setInterval(const int msecs);
+    void setMemoryLimit(const qint64 bytes);
+
+    void writeSummary(RunSummary &summary) const;
+
+    static Sample sampleProcess(const qint64 pid);
+
+public slots:
+    void setPhase(const QString &phase);
+    void start();
+    void stop();
+
+protected slots:
+    void sample();
+
+private:
+    struct Stats {
+        qint64 peakRssBytes;
+        qint64 totalRssBytes;
+        qint64 firstCpuMsecs;
+        qint64 lastCpuMsecs;
+        int count;
+        Stats() : peakRssBytes(0), totalRssBytes(0), firstCpuMsecs(0), lastCpuMsecs(0), count(0) { }
+    };
+
+    QTimer timer;
+    QMap<QString, QPointer<QWebEnginePage>> pages;
+    QString phase;
+    QStringList phases;
+    QMap<QString, QMap<QString, Stats>> stats; // Phase name -> process name -> stats.
+    qint64 memoryLimit;
+    bool limitExceeded;
+
+signals:
+    void memoryLimitExceeded(const qint64 rssBytes, const qint64 limitBytes);
+
+};
+
+#endif // RESOURCESAMPLER_H
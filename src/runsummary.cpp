@@ -0,0 +1,55 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QJsonDocument>
+
+#include "runsummary.h"
+
+void RunSummary::insert(const QString &section, const QString &key, const QVariant &value)
+{
+    sections[section].insert(key, value);
+}
+
+void RunSummary::insert(const QString &section, const QVariantMap &values)
+{
+    QVariantMap &map = sections[section];
+    for (auto iter = values.constBegin(); iter != values.constEnd(); ++iter) {
+        map.insert(iter.key(), iter.value());
+    }
+}
+
+QJsonObject RunSummary::toJson() const
+{
+    QJsonObject json;
+    for (auto iter = sections.constBegin(); iter != sections.constEnd(); ++iter) {
+        json.insert(iter.key(), QJsonObject::fromVariantMap(iter.value()));
+    }
+    return json;
+}
+
+void RunSummary::log() const
+{
+    // One line per section, so the summary remains easy to grep from cron logs.
+    for (auto iter = sections.constBegin(); iter != sections.constEnd(); ++iter) {
+        const QJsonDocument values(QJsonObject::fromVariantMap(iter.value()));
+        qInfo().noquote() << "Summary" << iter.key()
+                          << QString::fromUtf8(values.toJson(QJsonDocument::Compact));
+    }
+}
@@ -0,0 +1,42 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef RUNSUMMARY_H
+#define RUNSUMMARY_H
+
+#include <QJsonObject>
+#include <QMap>
+#include <QVariantMap>
+
+class RunSummary
+{
+
+public:
+    void insert(const QString &section, const QString &key, const QVariant &value);
+    void insert(const QString &section, const QVariantMap &values);
+
+    QJsonObject toJson() const;
+    void log() const;
+
+private:
+    QMap<QString, QVariantMap> sections;
+
+};
+
+#endif // RUNSUMMARY_H
@@ -1,7 +1,7 @@
 # Create a Qt application with QtWebEngine support.
 TEMPLATE = app
 TARGET = float
-QT += webenginewidgets
+QT += network webenginewidgets
 
 # Enable message log contexts (file, line, function).
 DEFINES += QT_MESSAGELOGCONTEXT
@@ -26,14 +26,60 @@ UI_DIR = $$DESTDIR/tmp
 
 # Include resources and source files.
 HEADERS += \
+  account.h \
+  archiveinterceptor.h \
+  archiveschemehandler.h \
+  controlclient.h \
+  controlserver.h \
+  coordinator.h \
+  exitcode.h \
+  exportwriter.h \
+  fetchcache.h \
   fitbit.h \
+  measurement.h \
   noninteractivewebpage.h \
   observablewebpage.h \
   polar.h \
+  readinesscondition.h \
+  readinessmonitor.h \
+  resourcesampler.h \
+  runsummary.h \
+  stagetimer.h \
+  synchistory.h \
+  syncjob.h \
+  trendengine.h \
+  warmup.h \
+  webarchive.h \
+  webhookreceiver.h \
+  worker.h \
+  writejournal.h \
+  writerecord.h \
 
 SOURCES += \
+  account.cpp \
+  archiveinterceptor.cpp \
+  archiveschemehandler.cpp \
+  controlclient.cpp \
+  controlserver.cpp \
+  coordinator.cpp \
+  exportwriter.cpp \
+  fetchcache.cpp \
   fitbit.cpp \
   main.cpp \
   noninteractivewebpage.cpp \
   observablewebpage.cpp \
   polar.cpp \
+  readinesscondition.cpp \
+  readinessmonitor.cpp \
+  resourcesampler.cpp \
+  runsummary.cpp \
+  stagetimer.cpp \
+  synchistory.cpp \
+  syncjob.cpp \
+  trendengine.cpp \
+  warmup.cpp \
+  webarchive.cpp \
+  webhookreceiver.cpp \
+  worker.cpp \
+  writejournal.cpp \
+  writerecord.cpp \
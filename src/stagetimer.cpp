@@ -0,0 +1,121 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+
+#include "exitcode.h"
+#include "stagetimer.h"
+
+StageTimer::StageTimer(QObject * parent) : QObject(parent), currentStage(None)
+{
+    deadline.setSingleShot(true);
+    connect(&deadline, &QTimer::timeout, this, &StageTimer::expire);
+}
+
+StageTimer::~StageTimer()
+{
+
+}
+
+/*!
+ * Set the wall-clock budget, in milliseconds, for each stage. Stages without a (positive) budget
+ * never expire.
+ */
+void StageTimer::setBudgets(const QMap<Stage, int> &msecs)
+{
+    budgets = msecs;
+}
+
+StageTimer::Stage StageTimer::stage() const
+{
+    return currentStage;
+}
+
+/*!
+ * Returns the process exit code for a failure caused by \a stage running out of time.
+ */
+int StageTimer::exitCode(const Stage stage)
+{
+    switch (stage) {
+    case Load:    return ExitCode::LoadTimeout;
+    case Login:   return ExitCode::LoginTimeout;
+    case Extract: return ExitCode::ExtractTimeout;
+    case Save:    return ExitCode::SaveTimeout;
+    case None:    break;
+    }
+    return ExitCode::Failure;
+}
+
+bool StageTimer::parseStage(const QString &name, Stage &stage)
+{
+    for (const Stage candidate: { Load, Login, Extract, Save }) {
+        if (name == stageName(candidate)) {
+            stage = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+QString StageTimer::stageName(const Stage stage)
+{
+    switch (stage) {
+    case None:    return QStringLiteral("none");
+    case Load:    return QStringLiteral("load");
+    case Login:   return QStringLiteral("login");
+    case Extract: return QStringLiteral("extract");
+    case Save:    return QStringLiteral("save");
+    }
+    return QString();
+}
+
+// Public Slots
+
+/*!
+ * Begin timing \a stage, replacing any stage already being timed.
+ */
+void StageTimer::start(const Stage stage)
+{
+    if (stage != currentStage) {
+        qDebug().noquote() << "Stage" << stageName(stage);
+    }
+    currentStage = stage;
+    if (budgets.value(stage) > 0) {
+        deadline.start(budgets.value(stage));
+    } else {
+        deadline.stop();
+    }
+}
+
+void StageTimer::stop()
+{
+    currentStage = None;
+    deadline.stop();
+}
+
+// Protected Slots
+
+void StageTimer::expire()
+{
+    qWarning().noquote() << "Stage" << stageName(currentStage) << "exceeded its budget of"
+                         << budgets.value(currentStage) << "ms";
+    const Stage stage = currentStage;
+    currentStage = None;
+    emit expired(stage);
+}
@@ -0,0 +1,68 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef STAGETIMER_H
+#define STAGETIMER_H
+
+#include <QMap>
+#include <QObject>
+#include <QTimer>
+
+class StageTimer : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Stage {
+        None,
+        Load,
+        Login,
+        Extract,
+        Save,
+    };
+    Q_ENUM(Stage)
+
+    explicit StageTimer(QObject * parent = Q_NULLPTR);
+    virtual ~StageTimer();
+
+    void setBudgets(const QMap<Stage, int> &msecs);
+    Stage stage() const;
+
+    static int exitCode(const Stage stage);
+    static bool parseStage(const QString &name, Stage &stage);
+    static QString stageName(const Stage stage);
+
+public slots:
+    void start(const Stage stage);
+    void stop();
+
+protected slots:
+    void expire();
+
+private:
+    QMap<Stage, int> budgets;
+    Stage currentStage;
+    QTimer deadline;
+
+signals:
+    void expired(const Stage stage);
+
+};
+
+#endif // STAGETIMER_H
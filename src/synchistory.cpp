@@ -0,0 +1,174 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QLockFile>
+
+#include "synchistory.h"
+
+#include <cmath>
+
+// Longest history line read; anything longer is skipped as corrupt.
+#define MAX_LINE_BYTES 4096
+
+/*!
+ * Constructs an append-only history of sync outcomes, in the \a fileName JSON Lines file. The file
+ * is locked while appended to, so multiple (worker) processes may safely share it. If \a fileName
+ * is empty, nothing is recorded.
+ */
+SyncHistory::SyncHistory(const QString &fileName) : historyFileName(fileName)
+{
+
+}
+
+QString SyncHistory::fileName() const
+{
+    return historyFileName;
+}
+
+/*!
+ * Appends \a entry to the history.
+ */
+bool SyncHistory::append(const Entry &entry)
+{
+    if (historyFileName.isEmpty()) {
+        return true; // History disabled.
+    }
+
+    QLockFile lock(historyFileName + QStringLiteral(".lock"));
+    if (!lock.lock()) {
+        qWarning() << "Failed to lock" << historyFileName << lock.error();
+        return false;
+    }
+
+    QFile file(historyFileName);
+    if (!file.open(QIODevice::ReadWrite|QIODevice::Append)) {
+        qWarning() << "Failed to open" << historyFileName << file.errorString();
+        return false;
+    }
+    QByteArray bytes = QJsonDocument(toJson(entry)).toJson(QJsonDocument::Compact) + '\n';
+
+    // Terminate any torn final line (eg from a crash mid-write), so it can't corrupt this one.
+    if ((file.size() > 0) && (file.seek(file.size() - 1)) && (file.read(1) != "\n")) {
+        bytes.prepend('\n');
+    }
+    if ((file.write(bytes) != bytes.size()) || (!file.flush())) {
+        qWarning() << "Failed to write to" << historyFileName << file.errorString();
+        return false;
+    }
+    return true;
+}
+
+/*!
+ * Streams the history, oldest first, to \a visit one entry at a time, until \a visit returns
+ * \c false. Only one line is held in memory at a time, so the history may be arbitrarily large.
+ * Returns the number of entries visited, or -1 if the history could not be read.
+ */
+qint64 SyncHistory::read(const std::function<bool(const Entry &entry)> &visit) const
+{
+    QFile file(historyFileName);
+    if (!file.exists()) {
+        return 0; // Nothing recorded yet.
+    }
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open" << historyFileName << file.errorString();
+        return -1;
+    }
+
+    char line[MAX_LINE_BYTES];
+    qint64 count = 0;
+    while (!file.atEnd()) {
+        const qint64 length = file.readLine(line, sizeof(line));
+        if (length < 0) {
+            qWarning() << "Failed to read" << historyFileName << file.errorString();
+            return -1;
+        }
+
+        // Skip any unterminated (ie, still being appended) last line, and over-long lines.
+        if ((length == 0) || (line[length - 1] != '\n')) {
+            if (file.atEnd()) {
+                break;
+            }
+            qWarning() << "Skipping over-long history line" << (count + 1);
+            qint64 rest;
+            do {
+                rest = file.readLine(line, sizeof(line));
+            } while ((rest > 0) && (line[rest - 1] != '\n'));
+            continue;
+        }
+
+        const QJsonDocument document =
+            QJsonDocument::fromJson(QByteArray::fromRawData(line, static_cast<int>(length)));
+        if (!document.isObject()) {
+            qWarning() << "Skipping corrupt history line" << (count + 1);
+            continue;
+        }
+        ++count;
+        if (!visit(fromJson(document.object()))) {
+            break;
+        }
+    }
+    return count;
+}
+
+SyncHistory::Entry SyncHistory::fromJson(const QJsonObject &json)
+{
+    Entry entry;
+    entry.time = QDateTime::fromString(json.value(QLatin1String("time")).toString(),
+                                       Qt::ISODateWithMs);
+    entry.account = json.value(QLatin1String("account")).toString();
+    entry.measurement.date = QDateTime::fromString(json.value(QLatin1String("date")).toString(),
+                                                   Qt::ISODate);
+    entry.measurement.weight = static_cast<float>(json.value(QLatin1String("weight")).toDouble());
+    entry.measurement.bodyFat = static_cast<float>(json.value(QLatin1String("bodyFat")).toDouble());
+    entry.source = json.value(QLatin1String("source")).toString();
+    entry.status = json.value(QLatin1String("status")).toString();
+    entry.written = json.value(QLatin1String("written")).toDouble();
+    return entry;
+}
+
+/*!
+ * Returns \a value (a weight or body fat percentage) to the two decimal places Fitbit reports,
+ * without the noise of its single precision representation.
+ */
+double SyncHistory::reported(const float value)
+{
+    return std::round(static_cast<double>(value) * 100.0) / 100.0;
+}
+
+QJsonObject SyncHistory::toJson(const Entry &entry)
+{
+    QJsonObject json{
+        { QStringLiteral("time"), entry.time.toUTC().toString(Qt::ISODateWithMs) },
+        { QStringLiteral("account"), entry.account },
+        { QStringLiteral("date"), entry.measurement.id() },
+        { QStringLiteral("weight"), reported(entry.measurement.weight) },
+        { QStringLiteral("source"), entry.source },
+        { QStringLiteral("status"), entry.status },
+    };
+    if (entry.measurement.bodyFat > 0) {
+        json.insert(QStringLiteral("bodyFat"), reported(entry.measurement.bodyFat));
+    }
+    if (entry.written > 0) {
+        json.insert(QStringLiteral("written"), entry.written);
+    }
+    return json;
+}
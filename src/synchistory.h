@@ -0,0 +1,61 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNCHISTORY_H
+#define SYNCHISTORY_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QString>
+
+#include <functional>
+
+#include "measurement.h"
+
+class SyncHistory
+{
+
+public:
+    struct Entry {
+        QDateTime time;          // When the outcome was recorded.
+        QString account;         // Account name; eg the credentials file name.
+        Measurement measurement;
+        QString source;          // Where the measurement came from: "fitbit" or "cache".
+        QString status;          // What became of it: "synced", "current", "rejected" or "failed".
+        double written;          // Mass (ie, the trend) Polar holds, if synced or current.
+        Entry() : written(0) { }
+    };
+
+    explicit SyncHistory(const QString &fileName);
+
+    QString fileName() const;
+
+    bool append(const Entry &entry);
+    qint64 read(const std::function<bool(const Entry &entry)> &visit) const;
+
+    static Entry fromJson(const QJsonObject &json);
+    static double reported(const float value);
+    static QJsonObject toJson(const Entry &entry);
+
+private:
+    QString historyFileName;
+
+};
+
+#endif // SYNCHISTORY_H
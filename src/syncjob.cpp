@@ -0,0 +1,433 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QSharedPointer>
+#include <QTimer>
+#include <QWebEngineProfile>
+#include <QWebEngineScript>
+
+#include "archiveinterceptor.h"
+#include "archiveschemehandler.h"
+#include "exitcode.h"
+#include "polar.h"
+#include "resourcesampler.h"
+#include "syncjob.h"
+#include "warmup.h"
+#include "webarchive.h"
+#include "writerecord.h"
+
+SyncJob::SyncJob(const Account &account, const Options &options, QObject * parent)
+    : QObject(parent), syncAccount(account), options(options),
+      cache(options.stateFileName, QStringLiteral("Fitbit/%1").arg(account.fitbitUsername)),
+      journal(options.journalFileName), trend(options.trend), history(options.historyFileName),
+      fetchExitCode(ExitCode::Success), fitbit(Q_NULLPTR), polar(Q_NULLPTR), sampler(Q_NULLPTR),
+      archive(Q_NULLPTR), interceptor(Q_NULLPTR), isFinished(false)
+{
+    cache.setDaily(options.fetchDaily);
+    cache.setTtl(options.fetchTtlSecs);
+    cache.setWindow(options.fetchWindowStart, options.fetchWindowEnd);
+    trend.append(account.polarUsername);
+    trend.load(options.stateFileName);
+
+    deadline.setSingleShot(true);
+    connect(&deadline, &QTimer::timeout, this, [this]() {
+        qCritical() << "Aborting: sync exceeded its overall budget of"
+                    << this->options.overallBudget << "ms";
+        runSummary.insert(QStringLiteral("run"), QStringLiteral("error"),
+                          QStringLiteral("Overall deadline exceeded"));
+        finish(ExitCode::OverallTimeout);
+    });
+}
+
+SyncJob::~SyncJob()
+{
+    // Delete the sites explicitly (rather than via QObject parenting) so their web pages, and
+    // thus renderer processes, are released before the sampler that is watching them.
+    delete fitbit;
+    delete polar;
+    delete archive;
+}
+
+Account SyncJob::account() const
+{
+    return syncAccount;
+}
+
+RunSummary SyncJob::summary() const
+{
+    return runSummary;
+}
+
+/*!
+ * Returns \c true if the account is already up to date, so starting the job would not load any
+ * pages (or start the web engine at all). That is, if the cached Fitbit measurement is still fresh,
+ * and its trend weight (along with any deferred writes) has already been written to Polar Flow.
+ *
+ * The cached measurement is folded into a copy of the account's trend, so checking changes nothing;
+ * neither the job's trend, nor the state file.
+ */
+bool SyncJob::isUpToDate() const
+{
+    TrendEngine probe(trend);
+    return (cache.skipFetch()) && (!needsWrite(cache.measurement(), probe)) &&
+           (journal.pending(syncAccount.polarUsername).isEmpty());
+}
+
+// Public Slots
+
+/*!
+ * Begin syncing the account. The web engine is only started if there's actually work to do.
+ */
+void SyncJob::start()
+{
+    qInfo().noquote() << "Syncing" << syncAccount.name;
+
+    // Check if the last fetched Fitbit measurement is still fresh enough to use.
+    QString skipReason;
+    const bool skipFetch = cache.skipFetch(&skipReason);
+    if (skipFetch) {
+        // If the cached measurement (and any previously deferred writes) has already been written
+        // too, then there's nothing to do, and no need to start the web engine at all.
+        const Measurement measurement = cache.measurement();
+        qInfo().noquote() << "Skipping Fitbit fetch:" << skipReason;
+        runSummary.insert(QStringLiteral("fitbit"), QStringLiteral("skipped"), skipReason);
+        const bool unwritten = needsWrite(measurement, trend);
+        trend.save(options.stateFileName);
+        if (unwritten) {
+            queueWrite(measurement);
+            outcome.measurement = measurement;
+            outcome.source = QStringLiteral("cache");
+        }
+        if (journal.pending(syncAccount.polarUsername).isEmpty()) {
+            QTimer::singleShot(0, this, [this]() { finish(ExitCode::Success); });
+            return;
+        }
+    }
+
+    // Record, or replay, all of the sites' requests if asked to.
+    if ((!options.recordDir.isEmpty()) || (!options.replayDir.isEmpty())) {
+        archive = options.recordDir.isEmpty()
+            ? new WebArchive(options.replayDir, WebArchive::Mode::Replay)
+            : new WebArchive(options.recordDir, WebArchive::Mode::Record);
+        if (!archive->open()) {
+            QTimer::singleShot(0, this, [this]() { finish(ExitCode::Failure); });
+            return;
+        }
+        interceptor = new ArchiveInterceptor(archive->mode(), this);
+    }
+
+    // Bound the whole sync, including any retries, regardless of the per-stage budgets.
+    if (options.overallBudget > 0) {
+        deadline.start(options.overallBudget);
+    }
+
+    // Load each site with its warmed up profile (and thus connections), if we're first to claim it.
+    polar = new Polar(syncAccount.polarUsername, syncAccount.polarPassword,
+                      claimProfile(Polar::origin()));
+    installArchive(polar->webPage());
+    polar->setStateFile(options.stateFileName);
+    polar->setTolerance(tolerance(trend));
+    polar->setVerifyAfter(options.verifyAfterSecs);
+    polar->setStageBudgets(options.stageBudgets);
+    polar->setMaxRetries(options.retries);
+    connect(polar, &Polar::failed, this, &SyncJob::onFailed);
+    connect(polar, &Polar::weightSet, this, &SyncJob::onWeightSet);
+
+    // Sample the browser and renderer processes' resource usage, per phase.
+    sampler = new ResourceSampler(this);
+    sampler->addPage(QStringLiteral("polar"), polar->webPage());
+    sampler->setInterval(options.sampleInterval);
+    sampler->setMemoryLimit(options.memoryLimit);
+    connect(sampler, &ResourceSampler::memoryLimitExceeded, this, [this](const qint64 rssBytes) {
+        qCritical() << "Aborting: memory use of" << (rssBytes / 1024 / 1024) << "MiB exceeds limit";
+        finish(ExitCode::MemoryLimit);
+    });
+
+    // Keep sampling the sites' renderer processes when their pages are recreated (after a crash).
+    connect(polar, &Polar::pageChanged, this, [this](QWebEnginePage * page) {
+        sampler->addPage(QStringLiteral("polar"), page);
+    });
+
+    // Note how long each site takes to start responding (eg, to compare with, and without warm-up).
+    recordTiming(QStringLiteral("polar"), polar->webPage());
+
+    if (skipFetch) {
+        // Push the cached measurement (or any deferred writes), since Polar doesn't have it yet.
+        sampler->start();
+        flush();
+        return;
+    }
+
+    // Have Polar Flow connected, and ready, for when the Fitbit weight arrives.
+    if ((options.warmUp) && (options.replayDir.isEmpty())) {
+        polar->preconnect();
+    }
+
+    fitbit = new Fitbit(syncAccount.fitbitUsername, syncAccount.fitbitPassword,
+                        claimProfile(Fitbit::origin()));
+    fitbit->setExtraction(options.extraction, options.extractionDataUrl);
+    installArchive(fitbit->webPage());
+    fitbit->setStageBudgets(options.stageBudgets);
+    fitbit->setMaxRetries(options.retries);
+    connect(fitbit, &Fitbit::failed, this, &SyncJob::onFetchFailed);
+    connect(fitbit, &Fitbit::weightFound, this, &SyncJob::onWeightFound);
+    connect(fitbit, &Fitbit::pageChanged, this, [this](QWebEnginePage * page) {
+        sampler->addPage(QStringLiteral("fitbit"), page);
+    });
+    sampler->addPage(QStringLiteral("fitbit"), fitbit->webPage());
+    recordTiming(QStringLiteral("fitbit"), fitbit->webPage());
+    sampler->setPhase(QStringLiteral("fitbit"));
+    sampler->start();
+    fitbit->fetchWeight();
+}
+
+// Protected Methods
+
+/*!
+ * Returns the warmed up profile for \a origin, if warming up, and no other job has claimed it yet.
+ */
+QWebEngineProfile * SyncJob::claimProfile(const QUrl &origin) const
+{
+    return (options.warmup) ? options.warmup->claimProfile(origin) : Q_NULLPTR;
+}
+
+/*!
+ * Write the newest of the account's pending writes to Polar, coalescing any older ones into it
+ * (they'll be resolved, as superseded, once it is written). The \a latest entry is included even if
+ * it could not be journaled.
+ */
+void SyncJob::flush(const WriteJournal::Entry &latest)
+{
+    QList<WriteJournal::Entry> pending = journal.pending(syncAccount.polarUsername);
+    if ((!latest.measurement.isEmpty()) &&
+        ((pending.isEmpty()) || (pending.last().measurement < latest.measurement))) {
+        pending.append(latest);
+    }
+    Q_ASSERT(!pending.isEmpty());
+    const WriteJournal::Entry newest = pending.last();
+    if (pending.size() > 1) {
+        qInfo().noquote() << QStringLiteral("Coalescing %1 pending writes; writing only %2")
+                             .arg(pending.size()).arg(newest.measurement);
+    }
+    runSummary.insert(QStringLiteral("journal"), QStringLiteral("coalesced"), pending.size());
+    writingMeasurement = newest.measurement;
+    sampler->setPhase(QStringLiteral("polar"));
+    polar->setWeight(newest.mass, newest.measurement);
+}
+
+/*!
+ * Fold the (cached) \a measurement into the account's \a engine (without saving it), and returns
+ * \c true if the resulting trend weight has yet to be written to Polar Flow.
+ */
+bool SyncJob::needsWrite(const Measurement &measurement, TrendEngine &engine) const
+{
+    if (!measurement.isValid()) {
+        return false;
+    }
+    // Fold the measurement into the trend; a no-op unless it postdates the trend (so repeatable).
+    engine.update(0, measurement.date, measurement.weight);
+    return (engine.count(0) > 0) &&
+        (!WriteRecord(options.stateFileName,
+                      QStringLiteral("Polar/%1").arg(syncAccount.polarUsername))
+         .isCurrent(trendMass(engine), tolerance(engine), options.verifyAfterSecs));
+}
+
+/*!
+ * Route all of \a page's requests via the web archive, if one is in use.
+ */
+void SyncJob::installArchive(QWebEnginePage * page)
+{
+    if (!archive) {
+        return;
+    }
+    QWebEngineProfile * const profile = page->profile();
+    ArchiveSchemeHandler * const handler = new ArchiveSchemeHandler(archive, profile, this);
+    handler->setLatency(options.replayLatency);
+    profile->installUrlSchemeHandler(ARCHIVE_SCHEME, handler);
+    profile->setUrlRequestInterceptor(interceptor);
+}
+
+/*!
+ * Write the network timing of \a page's first (non-blank) navigation to the run summary, under
+ * the \a site's timing section.
+ */
+void SyncJob::recordTiming(const QString &site, QWebEnginePage * page)
+{
+    const QSharedPointer<QMetaObject::Connection> connection(new QMetaObject::Connection);
+    *connection = connect(page, &QWebEnginePage::loadFinished, this,
+                          [this, site, page, connection](const bool ok) {
+        const QString scheme = page->url().scheme();
+        if ((!ok) || (scheme == QLatin1String("about")) || (scheme == QLatin1String("data"))) {
+            return; // Not the site itself (yet).
+        }
+        disconnect(*connection);
+        page->runJavaScript(QStringLiteral(R"JS(
+            (() => {
+                const entry = performance.getEntriesByType('navigation')[0];
+                return (entry === undefined) ? null : {
+                    dnsMsecs: entry.domainLookupEnd - entry.domainLookupStart,
+                    connectMsecs: entry.connectEnd - entry.connectStart,
+                    tlsMsecs: (entry.secureConnectionStart > 0)
+                        ? entry.connectEnd - entry.secureConnectionStart : 0,
+                    ttfbMsecs: entry.responseStart - entry.startTime,
+                };
+            })()
+        )JS"), QWebEngineScript::ApplicationWorld, [this, site](const QVariant &result) {
+            const QVariantMap map = result.toMap();
+            if (map.isEmpty()) {
+                return; // No navigation timing (or the page was deleted first).
+            }
+            QVariantMap timing;
+            for (auto iter = map.constBegin(); iter != map.constEnd(); ++iter) {
+                timing.insert(iter.key(), qRound64(iter.value().toDouble()));
+            }
+            runSummary.insert(QStringLiteral("timing.%1").arg(site), timing);
+        });
+    });
+}
+
+/*!
+ * Durably journal \a measurement as pending a write to Polar, so that it's not lost if the write
+ * fails (or the process dies) before completing. Returns the journaled entry.
+ */
+WriteJournal::Entry SyncJob::queueWrite(const Measurement &measurement)
+{
+    WriteJournal::Entry entry;
+    entry.account = syncAccount.polarUsername;
+    entry.measurement = measurement.id();
+    entry.mass = trendMass(trend);
+    entry.queued = QDateTime::currentDateTimeUtc();
+    if (!journal.append(entry)) {
+        qWarning() << "Failed to journal the write of" << entry.measurement;
+    }
+    return entry;
+}
+
+/*!
+ * Returns the smallest change from the last written weight worth writing; either the --tolerance,
+ * or the account's \a engine's significance threshold (which tracks its scale's noise), if larger.
+ */
+double SyncJob::tolerance(const TrendEngine &engine) const
+{
+    return qMax(options.tolerance, engine.threshold(0));
+}
+
+/*!
+ * Returns the weight to write; the account's \a engine's trend (rounded to the 0.1 kg that scales
+ * report), rather than the latest raw measurement.
+ */
+double SyncJob::trendMass(const TrendEngine &engine)
+{
+    return qRound(engine.level(0) * 10.0) / 10.0;
+}
+
+// Protected Slots
+
+void SyncJob::finish(const int exitCode)
+{
+    if (isFinished) {
+        return;
+    }
+    isFinished = true;
+    deadline.stop();
+
+    // Record what became of this sync's measurement (if any), for later export.
+    if (outcome.measurement.isValid()) {
+        outcome.time = QDateTime::currentDateTimeUtc();
+        outcome.account = syncAccount.name;
+        if (outcome.status.isEmpty()) {
+            outcome.status = QStringLiteral("failed");
+        }
+        history.append(outcome);
+    }
+    if (sampler) {
+        sampler->stop();
+        sampler->writeSummary(runSummary);
+    }
+    runSummary.insert(QStringLiteral("journal"), QStringLiteral("pending"),
+                      journal.pending(syncAccount.polarUsername).size());
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("exitCode"), exitCode);
+    emit finished(exitCode);
+}
+
+void SyncJob::onFailed(const QString &reason, const int exitCode)
+{
+    qWarning().noquote() << "Sync failed for" << syncAccount.name << reason;
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("error"), reason);
+    finish(exitCode);
+}
+
+/*!
+ * Even without a new (or acceptable) measurement from Fitbit, any previously deferred writes can
+ * still be flushed to Polar; the run still fails with \a exitCode though.
+ */
+void SyncJob::onFetchFailed(const QString &reason, const int exitCode)
+{
+    if ((!writingMeasurement.isEmpty()) || (journal.pending(syncAccount.polarUsername).isEmpty())) {
+        onFailed(reason, exitCode);
+        return;
+    }
+    qWarning().noquote() << "No new weight for" << syncAccount.name << reason
+                         << "(flushing deferred writes anyway)";
+    runSummary.insert(QStringLiteral("run"), QStringLiteral("error"), reason);
+    fetchExitCode = exitCode;
+    flush();
+}
+
+void SyncJob::onWeightFound(const Measurement &measurement)
+{
+    // Fitbit keeps re-reading its page as it changes; only the first measurement is of interest.
+    disconnect(fitbit, &Fitbit::weightFound, this, &SyncJob::onWeightFound);
+    cache.save(measurement);
+    runSummary.insert(QStringLiteral("fitbit"), QStringLiteral("measurement"), measurement.id());
+    runSummary.insert(QStringLiteral("fitbit"), QStringLiteral("weight"), measurement.weight);
+    outcome.measurement = measurement;
+    outcome.source = QStringLiteral("fitbit");
+
+    // Screen the measurement against (and fold it into) the account's trend. Outliers are never
+    // journaled, so are never written, but any previously deferred writes are flushed regardless.
+    const TrendEngine::Verdict verdict = trend.update(0, measurement.date, measurement.weight);
+    trend.save(options.stateFileName);
+    trend.writeSummary(runSummary, 0, verdict);
+    if ((verdict == TrendEngine::Rejected) || (trend.count(0) == 0)) {
+        outcome.status = QStringLiteral("rejected");
+        onFetchFailed(QStringLiteral("Rejected weight %1 kg as an outlier from the %2 kg trend")
+                      .arg(measurement.weight).arg(trend.level(0), 0, 'f', 1), ExitCode::Failure);
+        return;
+    }
+    polar->setTolerance(tolerance(trend));
+    flush(queueWrite(measurement));
+}
+
+/*!
+ * Polar Flow now holds \a mass; either \a written just now, or already (within tolerance), in which
+ * case the write was skipped.
+ */
+void SyncJob::onWeightSet(const double mass, const bool written)
+{
+    journal.markWritten(syncAccount.polarUsername, writingMeasurement);
+    runSummary.insert(QStringLiteral("polar"), QStringLiteral("weight"), mass);
+    runSummary.insert(QStringLiteral("polar"), QStringLiteral("written"), written);
+    if ((outcome.measurement.isValid()) && (writingMeasurement == outcome.measurement.id())) {
+        outcome.status = (written) ? QStringLiteral("synced") : QStringLiteral("current");
+        outcome.written = mass;
+    }
+    finish(fetchExitCode);
+}
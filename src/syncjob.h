@@ -0,0 +1,134 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef SYNCJOB_H
+#define SYNCJOB_H
+
+#include <QObject>
+#include <QPointer>
+#include <QRegularExpression>
+#include <QTime>
+#include <QTimer>
+
+#include "account.h"
+#include "fetchcache.h"
+#include "fitbit.h"
+#include "measurement.h"
+#include "runsummary.h"
+#include "stagetimer.h"
+#include "synchistory.h"
+#include "trendengine.h"
+#include "writejournal.h"
+
+class ArchiveInterceptor;
+class Polar;
+class QWebEnginePage;
+class QWebEngineProfile;
+class ResourceSampler;
+class Warmup;
+class WebArchive;
+
+class SyncJob : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options {
+        QString stateFileName;
+        QString journalFileName;
+        QString historyFileName;
+        double tolerance;
+        qint64 verifyAfterSecs;
+        bool fetchDaily;
+        qint64 fetchTtlSecs;
+        QTime fetchWindowStart;
+        QTime fetchWindowEnd;
+        int sampleInterval;
+        qint64 memoryLimit;
+        QString recordDir;
+        QString replayDir;
+        int replayLatency;
+        Fitbit::Extraction extraction;
+        QRegularExpression extractionDataUrl;
+        QMap<StageTimer::Stage, int> stageBudgets;
+        int overallBudget;
+        int retries;
+        bool warmUp;
+        QPointer<Warmup> warmup; // Of the sites' profiles, for the first job to claim.
+        TrendEngine::Parameters trend;
+        Options() : tolerance(0.05), verifyAfterSecs(0), fetchDaily(false), fetchTtlSecs(0),
+                    sampleInterval(1000), memoryLimit(0), replayLatency(0),
+                    extraction(Fitbit::Extraction::Auto), overallBudget(0), retries(0),
+                    warmUp(true) { }
+    };
+
+    SyncJob(const Account &account, const Options &options, QObject * parent = Q_NULLPTR);
+    virtual ~SyncJob();
+
+    Account account() const;
+    RunSummary summary() const;
+
+    bool isUpToDate() const;
+
+public slots:
+    void start();
+
+protected:
+    static double trendMass(const TrendEngine &engine);
+
+    QWebEngineProfile * claimProfile(const QUrl &origin) const;
+    void flush(const WriteJournal::Entry &latest = WriteJournal::Entry());
+    void installArchive(QWebEnginePage * page);
+    bool needsWrite(const Measurement &measurement, TrendEngine &engine) const;
+    WriteJournal::Entry queueWrite(const Measurement &measurement);
+    void recordTiming(const QString &site, QWebEnginePage * page);
+    double tolerance(const TrendEngine &engine) const;
+
+protected slots:
+    void finish(const int exitCode);
+    void onFailed(const QString &reason, const int exitCode);
+    void onFetchFailed(const QString &reason, const int exitCode);
+    void onWeightFound(const Measurement &measurement);
+    void onWeightSet(const double mass, const bool written);
+
+private:
+    const Account syncAccount;
+    const Options options;
+    FetchCache cache;
+    WriteJournal journal;
+    TrendEngine trend;
+    SyncHistory history;
+    SyncHistory::Entry outcome; // Of this sync's measurement.
+    QString writingMeasurement;
+    int fetchExitCode;
+    Fitbit * fitbit;
+    Polar * polar;
+    ResourceSampler * sampler;
+    WebArchive * archive;
+    ArchiveInterceptor * interceptor;
+    RunSummary runSummary;
+    QTimer deadline;
+    bool isFinished;
+
+signals:
+    void finished(const int exitCode);
+
+};
+
+#endif // SYNCJOB_H
@@ -0,0 +1,303 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QSettings>
+#include <QtNumeric>
+
+#include <algorithm>
+#include <cmath>
+
+#include "runsummary.h"
+#include "trendengine.h"
+
+// Scales a mean absolute deviation to the standard deviation of normally distributed noise.
+#define MEAN_DEVIATION_TO_SIGMA 1.2533141373155
+
+/*!
+ * Constructs an empty trend engine, which smooths and screens measurements per \a parameters.
+ */
+TrendEngine::TrendEngine(const Parameters &parameters) : parameters(parameters)
+{
+
+}
+
+/*!
+ * Appends a (historyless) trend for the account identified by \a key, returning its index.
+ */
+int TrendEngine::append(const QString &key)
+{
+    keys.append(key);
+    lastDates.append(0);
+    levels.append(0.0);
+    noises.append(parameters.initialNoise);
+    counts.append(0);
+    rejectionCounts.append(0);
+    return keys.size() - 1;
+}
+
+int TrendEngine::size() const
+{
+    return keys.size();
+}
+
+/*!
+ * Returns the number of measurements the \a index trend has accepted since it was last reset.
+ */
+int TrendEngine::count(const int index) const
+{
+    return counts.at(index);
+}
+
+QString TrendEngine::key(const int index) const
+{
+    return keys.at(index);
+}
+
+/*!
+ * Returns the smoothed (trend) mass, in kilograms, of the \a index trend.
+ */
+double TrendEngine::level(const int index) const
+{
+    return levels.at(index);
+}
+
+/*!
+ * Returns the estimated standard deviation, in kilograms, of the \a index trend's measurements.
+ */
+double TrendEngine::noise(const int index) const
+{
+    return std::max(noises.at(index), parameters.minNoise);
+}
+
+/*!
+ * Returns the number of consecutive measurements the \a index trend has rejected.
+ */
+int TrendEngine::rejections(const int index) const
+{
+    return rejectionCounts.at(index);
+}
+
+/*!
+ * Returns the smallest change, in kilograms, in the \a index trend's level that is significant.
+ */
+double TrendEngine::threshold(const int index) const
+{
+    double result;
+    thresholds(1, noises.constData() + index, &result, parameters);
+    return result;
+}
+
+/*!
+ * Load each account's trend (if any) from the \a fileName state file.
+ */
+void TrendEngine::load(const QString &fileName)
+{
+    if (fileName.isEmpty()) {
+        return; // Persistence disabled.
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    for (int index = 0; index < keys.size(); ++index) {
+        settings.beginGroup(QStringLiteral("Trend/%1").arg(keys.at(index)));
+        const QDateTime date = settings.value(QStringLiteral("date")).toDateTime();
+        lastDates[index] = date.isValid() ? date.toMSecsSinceEpoch() : 0;
+        levels[index] = settings.value(QStringLiteral("level"), 0.0).toDouble();
+        noises[index] = settings.value(QStringLiteral("noise"), parameters.initialNoise).toDouble();
+        counts[index] = settings.value(QStringLiteral("count"), 0).toInt();
+        rejectionCounts[index] = settings.value(QStringLiteral("rejections"), 0).toInt();
+        settings.endGroup();
+    }
+}
+
+/*!
+ * Save each account's trend to the \a fileName state file.
+ */
+void TrendEngine::save(const QString &fileName) const
+{
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    for (int index = 0; index < keys.size(); ++index) {
+        settings.beginGroup(QStringLiteral("Trend/%1").arg(keys.at(index)));
+        settings.setValue(QStringLiteral("date"),
+                          QDateTime::fromMSecsSinceEpoch(lastDates.at(index), Qt::UTC));
+        settings.setValue(QStringLiteral("level"), levels.at(index));
+        settings.setValue(QStringLiteral("noise"), noises.at(index));
+        settings.setValue(QStringLiteral("count"), counts.at(index));
+        settings.setValue(QStringLiteral("rejections"), rejectionCounts.at(index));
+        settings.endGroup();
+    }
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qWarning() << "Failed to save trends to" << fileName << settings.status();
+    }
+}
+
+/*!
+ * Write the \a index trend, and the \a verdict on its latest measurement, to the \c trend section
+ * of \a summary.
+ */
+void TrendEngine::writeSummary(RunSummary &summary, const int index, const Verdict verdict) const
+{
+    summary.insert(QStringLiteral("trend"), {
+        { QStringLiteral("level"), level(index) },
+        { QStringLiteral("noise"), noise(index) },
+        { QStringLiteral("threshold"), threshold(index) },
+        { QStringLiteral("verdict"), toString(verdict) },
+    });
+}
+
+/*!
+ * Update the \a index trend with the \a mass measured at \a date, returning the verdict on it.
+ */
+TrendEngine::Verdict TrendEngine::update(const int index, const QDateTime &date, const double mass)
+{
+    const qint64 msecs = date.isValid() ? date.toMSecsSinceEpoch() : 0;
+    const double fresh = (msecs > lastDates.at(index)) ? mass : qQNaN();
+    lastDates[index] = std::max(msecs, lastDates.at(index));
+    Verdict verdict;
+    update(1, &fresh, levels.data() + index, noises.data() + index, counts.data() + index,
+           rejectionCounts.data() + index, &verdict, parameters);
+    return verdict;
+}
+
+/*!
+ * Update every trend, in one pass, with the measurement \a masses at \a dates (milliseconds since
+ * the epoch, or zero where an account has no new measurement), setting \a verdicts on each.
+ *
+ * Note, each sync holds just its own account's trend, so only ever updates it via the per-trend
+ * update above (a batch of one).
+ */
+void TrendEngine::update(const QVector<qint64> &dates, const QVector<double> &masses,
+                         QVector<Verdict> &verdicts)
+{
+    Q_ASSERT(dates.size() == keys.size());
+    Q_ASSERT(masses.size() == keys.size());
+
+    // Only measurements newer than each trend's last are new, so re-fetches aren't counted twice.
+    QVector<double> fresh(keys.size());
+    for (int index = 0; index < keys.size(); ++index) {
+        fresh[index] = (dates.at(index) > lastDates.at(index)) ? masses.at(index) : qQNaN();
+        lastDates[index] = std::max(dates.at(index), lastDates.at(index));
+    }
+    verdicts.resize(keys.size());
+    update(keys.size(), fresh.constData(), levels.data(), noises.data(), counts.data(),
+           rejectionCounts.data(), verdicts.data(), parameters);
+}
+
+QString TrendEngine::toString(const Verdict verdict)
+{
+    switch (verdict) {
+    case Unchanged: return QStringLiteral("unchanged");
+    case Accepted:  return QStringLiteral("accepted");
+    case Rejected:  return QStringLiteral("rejected");
+    case Reset:     return QStringLiteral("reset");
+    }
+    return QString();
+}
+
+// Let GCC vectorize the batch kernels' branch-free loops (in this file only, so these options don't
+// affect any other code). Since the loops don't rely on floating point traps, it may also evaluate
+// both sides of their conditions.
+#if defined(Q_CC_GNU) && !defined(Q_CC_CLANG) && !defined(Q_CC_INTEL)
+#pragma GCC push_options
+#pragma GCC optimize("tree-vectorize", "vect-cost-model=dynamic", "no-trapping-math")
+#endif
+
+/*!
+ * Updates \a size trends with one measurement each, from \a masses (NaN where an account has no new
+ * measurement).
+ *
+ * Each measurement is screened against its trend: those outside the plausible mass range, or more
+ * than Parameters::outlierSigmas of noise from the trend, are rejected. Accepted measurements move
+ * the trend's level (an exponentially weighted moving average), and noise (a likewise weighted mean
+ * absolute deviation, scaled to a standard deviation). A run of Parameters::rebaseline consecutive
+ * (plausible) rejections is taken to be a real step change, and resets the trend.
+ *
+ * So that the compiler can vectorize the loop, its body is branch-free: each condition becomes a
+ * 0.0 or 1.0 weight, and the updates are weighted sums, over non-overlapping contiguous arrays.
+ */
+void TrendEngine::update(const int size, const double * __restrict masses,
+                         double * __restrict levels, double * __restrict noises,
+                         qint32 * __restrict counts, qint32 * __restrict rejections,
+                         Verdict * __restrict verdicts, const Parameters &parameters)
+{
+    // Copy the parameters, so the compiler knows the loop's stores can't change them.
+    const double alpha = parameters.alpha;
+    const double outlierSigmas = parameters.outlierSigmas;
+    const double minNoise = parameters.minNoise;
+    const double initialNoise = parameters.initialNoise;
+    const double minMass = parameters.minMass;
+    const double maxMass = parameters.maxMass;
+    const double rebaseline = parameters.rebaseline;
+
+    for (int index = 0; index < size; ++index) {
+        const double measured = masses[index];
+        const double level = levels[index];
+        const double noise = noises[index];
+        const double count = counts[index];
+        const double rejected = rejections[index];
+
+        // Clamp the measurement (which also replaces NaN), so that unused terms stay finite.
+        const double clamped = (measured > minMass) ? measured : minMass;
+        const double residual = ((clamped < maxMass) ? clamped : maxMass) - level;
+        const double deviation = std::fabs(residual);
+        const double noiseFloor = (noise > minNoise) ? noise : minNoise;
+
+        const double isNew = (measured == measured) ? 1.0 : 0.0; // Ie, not NaN.
+        const double plausible = ((measured > minMass) ? 1.0 : 0.0) *
+                                 ((measured < maxMass) ? 1.0 : 0.0);
+        const double first = (count < 1.0) ? 1.0 : 0.0;
+        const double deviates = (deviation > outlierSigmas * noiseFloor) ? 1.0 : 0.0;
+        const double stepped = (rejected + 1.0 >= rebaseline) ? 1.0 : 0.0;
+        const double reset = plausible * (first + ((1.0 - first) * deviates * stepped));
+        const double accept = plausible * (1.0 - first) * (1.0 - deviates);
+        const double reject = isNew - reset - accept;
+
+        levels[index] = level + ((reset + (alpha * accept)) * residual);
+        noises[index] = noise + (alpha * accept * ((MEAN_DEVIATION_TO_SIGMA * deviation) - noise))
+                              + (reset * (initialNoise - noise));
+        counts[index] = static_cast<qint32>(count + accept + (reset * (1.0 - count)));
+        rejections[index] = static_cast<qint32>(rejected + (reject * plausible)
+                                                - ((reset + accept) * rejected));
+        verdicts[index] = static_cast<Verdict>(static_cast<qint32>(
+            (reset * Reset) + (accept * Accepted) + (reject * Rejected)));
+    }
+}
+
+/*!
+ * Sets the \a size \a thresholds to the smallest significant change in each trend's level, given
+ * its measurement \a noises. That is, Parameters::significance times the standard deviation of the
+ * trend's level, which (for an exponentially weighted moving average) is the measurement noise
+ * scaled by sqrt(alpha / (2 - alpha)).
+ */
+void TrendEngine::thresholds(const int size, const double * noises, double * thresholds,
+                             const Parameters &parameters)
+{
+    const double scale = parameters.significance *
+        std::sqrt(parameters.alpha / (2.0 - parameters.alpha));
+    for (int index = 0; index < size; ++index) {
+        thresholds[index] = scale * std::max(noises[index], parameters.minNoise);
+    }
+}
+
+#if defined(Q_CC_GNU) && !defined(Q_CC_CLANG) && !defined(Q_CC_INTEL)
+#pragma GCC pop_options
+#endif
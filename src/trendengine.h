@@ -0,0 +1,95 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef TRENDENGINE_H
+#define TRENDENGINE_H
+
+#include <QDateTime>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+class RunSummary;
+
+class TrendEngine
+{
+
+public:
+    struct Parameters {
+        double alpha;           // Smoothing factor; 1 to follow the raw measurements exactly.
+        double outlierSigmas;   // Reject measurements further than this from the trend.
+        double significance;    // Only trend changes beyond this many sigmas are significant.
+        double minNoise;        // Floor (kg) for the noise estimate.
+        double initialNoise;    // Noise (kg) assumed until the history establishes its own.
+        double minMass;         // Physically plausible range (kg); anything outside is rejected.
+        double maxMass;
+        int rebaseline;         // Accept this many consecutive rejections as a real step change.
+        Parameters() : alpha(0.25), outlierSigmas(4.0), significance(2.0), minNoise(0.2),
+                       initialNoise(0.5), minMass(20.0), maxMass(350.0), rebaseline(3) { }
+    };
+
+    enum Verdict : qint8 {
+        Unchanged = 0, // No new measurement (absent, or not newer than the last one seen).
+        Accepted,
+        Rejected,
+        Reset,         // Accepted as the start of a new trend (the first, or after a step change).
+    };
+
+    explicit TrendEngine(const Parameters &parameters = Parameters());
+
+    int append(const QString &key);
+    int size() const;
+
+    int count(const int index) const;
+    QString key(const int index) const;
+    double level(const int index) const;
+    double noise(const int index) const;
+    int rejections(const int index) const;
+    double threshold(const int index) const;
+
+    void load(const QString &fileName);
+    void save(const QString &fileName) const;
+    void writeSummary(RunSummary &summary, const int index, const Verdict verdict) const;
+
+    Verdict update(const int index, const QDateTime &date, const double mass);
+    void update(const QVector<qint64> &dates, const QVector<double> &masses,
+                QVector<Verdict> &verdicts);
+
+    static QString toString(const Verdict verdict);
+
+    // Kernels over struct-of-arrays state, with one element per trend.
+    static void update(const int size, const double * __restrict masses,
+                       double * __restrict levels, double * __restrict noises,
+                       qint32 * __restrict counts, qint32 * __restrict rejections,
+                       Verdict * __restrict verdicts, const Parameters &parameters);
+    static void thresholds(const int size, const double * noises, double * thresholds,
+                           const Parameters &parameters);
+
+private:
+    Parameters parameters;
+    QStringList keys;
+    QVector<qint64> lastDates; // Milliseconds since the epoch.
+    QVector<double> levels;
+    QVector<double> noises;
+    QVector<qint32> counts;
+    QVector<qint32> rejectionCounts;
+
+};
+
+#endif // TRENDENGINE_H
@@ -0,0 +1,183 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <QDebug>
+#include <QWebEnginePage>
+#include <QWebEngineProfile>
+
+#include "runsummary.h"
+#include "warmup.h"
+
+#define TTFB_TITLE_PREFIX QStringLiteral("ttfb:")
+
+Warmup::Warmup(QObject * parent) : QObject(parent), engineMsecs(-1)
+{
+
+}
+
+Warmup::~Warmup()
+{
+    // Delete the pages explicitly, to ensure their deletion *before* their profiles'.
+    for (const Site &site: sites) {
+        delete site.page;
+    }
+}
+
+/*!
+ * Returns the warmed up profile for \a origin, with its connections to the origin already open, for
+ * the first page to load the origin to use; or \c Q_NULLPTR if the origin was not warmed up, or its
+ * profile has already been claimed (the profile carries the first page's cookies, so must not be
+ * shared with another account's). The profile remains owned by this object, which must outlive any
+ * pages using it.
+ */
+QWebEngineProfile * Warmup::claimProfile(const QUrl &origin)
+{
+    const auto iter = sites.find(origin.host());
+    if ((iter == sites.end()) || (!iter->profile) || (iter->claimed)) {
+        return Q_NULLPTR;
+    }
+    iter->claimed = true;
+    return iter->profile;
+}
+
+/*!
+ * Write the warm-up timings, so far, to the \a summary. For each origin, that includes the time to
+ * first byte of a request before warming up (over a new connection), and after (over the warmed up
+ * connection that the origin's page will reuse).
+ */
+void Warmup::writeSummary(RunSummary &summary) const
+{
+    const QString section = QStringLiteral("warmUp");
+    summary.insert(section, QStringLiteral("engineMsecs"), engineMsecs);
+    for (auto iter = sites.constBegin(); iter != sites.constEnd(); ++iter) {
+        summary.insert(section, QStringLiteral("coldTtfbMsecs.%1").arg(iter.key()),
+                       iter.value().coldTtfbMsecs);
+        summary.insert(section, QStringLiteral("warmTtfbMsecs.%1").arg(iter.key()),
+                       iter.value().warmTtfbMsecs);
+    }
+}
+
+// Public Slots
+
+/*!
+ * Stop warming up, releasing the pages (and their renderer processes), and profiles, that have not
+ * been claimed; eg, once it turns out that no sites will be loaded after all.
+ */
+void Warmup::cancel()
+{
+    qDebug() << "Cancelling warm-up after" << timer.elapsed() << "ms";
+    for (Site &site: sites) {
+        if ((site.claimed) || (!site.profile)) {
+            continue;
+        }
+        if (site.page) {
+            site.page->disconnect(this);
+            site.page->deleteLater();
+        }
+        site.profile->deleteLater(); // Deferred deletions happen in order, so after the page's.
+        site.profile = Q_NULLPTR;
+    }
+}
+
+/*!
+ * Begin warming up, in the background, for later requests to \a origins. This initialises the web
+ * engine (and launches renderer processes), and for each origin, creates the profile that the
+ * origin's page will use (see claimProfile), and requests the origin twice from a blank page. The
+ * first request resolves the host name, and connects (including the TLS handshake) to it, which the
+ * second request, and later the origin's page, then reuse. The engine's host cache and connection
+ * pools are per-profile, so this work is only of use to pages created with the same profile.
+ */
+void Warmup::start(const QList<QUrl> &origins)
+{
+    timer.start();
+    for (const QUrl &origin: origins) {
+        const QString host = origin.host();
+        if ((host.isEmpty()) || (sites.contains(host))) {
+            continue;
+        }
+        Site site;
+        site.profile = new QWebEngineProfile(this);
+        Q_ASSERT(site.profile->isOffTheRecord());
+        site.page = new QWebEnginePage(site.profile, this);
+        connect(site.page, &QWebEnginePage::loadFinished, this, [this](const bool ok) {
+            if (engineMsecs < 0) {
+                engineMsecs = timer.elapsed();
+                qDebug() << "Web engine warmed up in" << engineMsecs << "ms" << ok;
+            }
+        });
+        connect(site.page, &QWebEnginePage::titleChanged, this, [this, host](const QString &title) {
+            onProbed(host, title);
+        });
+        site.page->setHtml(probeHtml(origin), QUrl(QStringLiteral("about:blank")));
+        sites.insert(host, site);
+    }
+}
+
+// Protected Methods
+
+/*!
+ * Returns a blank page that requests \a origin twice in succession, and then sets its title to the
+ * time to first byte of each, or to an error message on failure.
+ */
+QString Warmup::probeHtml(const QUrl &origin)
+{
+    return QStringLiteral(R"HTML(
+        <script>
+            const probe = () => {
+                const started = performance.now();
+                return fetch('%1', { method: 'HEAD', mode: 'no-cors', credentials: 'include',
+                                     cache: 'no-store' })
+                    .then(() => Math.round(performance.now() - started));
+            };
+            probe().then((cold) => probe().then((warm) => {
+                document.title = '%2' + cold + ':' + warm;
+            })).catch((error) => {
+                document.title = '%2error:' + error.message;
+            });
+        </script>
+    )HTML").arg(origin.toString(QUrl::FullyEncoded), TTFB_TITLE_PREFIX);
+}
+
+// Protected Slots
+
+/*!
+ * Record the times to first byte given by the \a host's probe page \a title, if it has them yet.
+ */
+void Warmup::onProbed(const QString &host, const QString &title)
+{
+    if (!title.startsWith(TTFB_TITLE_PREFIX)) {
+        return; // Still probing.
+    }
+    Site &site = sites[host];
+    const QString result = title.mid(TTFB_TITLE_PREFIX.length());
+    if (result.startsWith(QLatin1String("error:"))) {
+        qWarning().noquote() << "Failed to warm up" << host << result.section(QLatin1Char(':'), 1);
+    } else {
+        site.coldTtfbMsecs = result.section(QLatin1Char(':'), 0, 0).toLongLong();
+        site.warmTtfbMsecs = result.section(QLatin1Char(':'), 1, 1).toLongLong();
+        qDebug() << "Warmed up" << host << "with time to first byte of" << site.coldTtfbMsecs
+                 << "ms before, and" << site.warmTtfbMsecs << "ms after";
+    }
+
+    // The probe page has served its purpose; release it (and its renderer process), but not its
+    // profile, which holds the warmed up connection.
+    if (site.page) {
+        site.page->disconnect(this);
+        site.page->deleteLater();
+    }
+}
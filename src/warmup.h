@@ -0,0 +1,68 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#ifndef WARMUP_H
+#define WARMUP_H
+
+#include <QElapsedTimer>
+#include <QMap>
+#include <QObject>
+#include <QPointer>
+#include <QUrl>
+
+class QWebEnginePage;
+class QWebEngineProfile;
+class RunSummary;
+
+class Warmup : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Warmup(QObject * parent = Q_NULLPTR);
+    virtual ~Warmup();
+
+    QWebEngineProfile * claimProfile(const QUrl &origin);
+    void writeSummary(RunSummary &summary) const;
+
+public slots:
+    void cancel();
+    void start(const QList<QUrl> &origins);
+
+protected:
+    static QString probeHtml(const QUrl &origin);
+
+protected slots:
+    void onProbed(const QString &host, const QString &title);
+
+private:
+    struct Site {
+        QWebEngineProfile * profile;
+        QPointer<QWebEnginePage> page;
+        bool claimed;
+        qint64 coldTtfbMsecs; // Time to first byte over a new connection, or -1 if unknown.
+        qint64 warmTtfbMsecs; // Time to first byte over the warmed connection, or -1 if unknown.
+        Site() : profile(Q_NULLPTR), claimed(false), coldTtfbMsecs(-1), warmTtfbMsecs(-1) { }
+    };
+    QElapsedTimer timer;
+    qint64 engineMsecs;
+    QMap<QString, Site> sites; // Host name -> warm-up state.
+
+};
+
+#endif // WARMUP_H
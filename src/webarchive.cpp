@@ -0,0 +1,242 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QByteArrayList>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QWebEngineUrlScheme>
+
+#include "webarchive.h"
+
+#define INDEX_FILE_NAME QStringLiteral("index.jsonl")
+
+/*!
+ * Construct an archive of web requests, and their responses, in the \a dirName directory.
+ *
+ * The archive consists of an `index.jsonl` file, with one JSON object per recorded response (its
+ * status, redirect location, and headers), and one (zlib compressed) body file per response.
+ */
+WebArchive::WebArchive(const QString &dirName, const Mode mode) : dir(dirName), archiveMode(mode)
+{
+
+}
+
+WebArchive::Mode WebArchive::mode() const
+{
+    return archiveMode;
+}
+
+/*!
+ * Open the archive, loading its index (if any). When recording, the archive directory is created
+ * if it does not already exist.
+ */
+bool WebArchive::open()
+{
+    if ((archiveMode == Mode::Record) && (!dir.mkpath(QStringLiteral(".")))) {
+        qCritical() << "Failed to create archive directory" << dir.absolutePath();
+        return false;
+    }
+
+    QFile index(dir.filePath(INDEX_FILE_NAME));
+    if (!index.exists()) {
+        if (archiveMode == Mode::Replay) {
+            qCritical() << "Archive index does not exist" << index.fileName();
+            return false;
+        }
+        return true; // A new archive.
+    }
+    if (!index.open(QIODevice::ReadOnly)) {
+        qCritical() << "Failed to open archive index" << index.fileName() << index.errorString();
+        return false;
+    }
+    // Later entries (eg from re-recording) replace earlier ones.
+    for (QByteArray line = index.readLine(); !line.isEmpty(); line = index.readLine()) {
+        const QJsonObject entry = QJsonDocument::fromJson(line).object();
+        entries.insert(entry.value(QStringLiteral("key")).toString().toLatin1(), entry);
+    }
+    qDebug() << "Loaded" << entries.size() << "archive entries from" << index.fileName();
+    return true;
+}
+
+/*!
+ * Loads the recorded \a response to the \a method request, with \a requestBody, for \a url,
+ * returning \c false if there is none. Entries recorded before statuses were archived are loaded as
+ * 200 (OK) responses.
+ */
+bool WebArchive::load(const QByteArray &method, const QUrl &url, const QByteArray &requestBody,
+                      Response &response) const
+{
+    const QByteArray entryKey = key(method, url, requestBody);
+    if (!entries.contains(entryKey)) {
+        return false;
+    }
+    QFile file(dir.filePath(QString::fromLatin1(entryKey)));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Failed to open archive entry" << file.fileName() << file.errorString();
+        return false;
+    }
+    const QJsonObject entry = entries.value(entryKey);
+    response.status = entry.value(QStringLiteral("status")).toInt(200);
+    response.mimeType = entry.value(QStringLiteral("mimeType")).toString().toLatin1();
+    response.location = QUrl(entry.value(QStringLiteral("location")).toString());
+    response.headers.clear();
+    for (const QJsonValue &header: entry.value(QStringLiteral("headers")).toArray()) {
+        response.headers.append(qMakePair(header.toArray().at(0).toString().toLatin1(),
+                                          header.toArray().at(1).toString().toLatin1()));
+    }
+    response.body = qUncompress(file.readAll());
+    return true;
+}
+
+/*!
+ * Records the \a response to the \a method request, with \a requestBody, for \a url, replacing any
+ * earlier one.
+ */
+bool WebArchive::store(const QByteArray &method, const QUrl &url, const QByteArray &requestBody,
+                       const Response &response)
+{
+    Q_ASSERT(archiveMode == Mode::Record);
+    const QByteArray entryKey = key(method, url, requestBody);
+    QFile file(dir.filePath(QString::fromLatin1(entryKey)));
+    if ((!file.open(QIODevice::WriteOnly)) || (file.write(qCompress(response.body)) < 0)) {
+        qWarning() << "Failed to write archive entry" << file.fileName() << file.errorString();
+        return false;
+    }
+
+    QFile index(dir.filePath(INDEX_FILE_NAME));
+    if (!index.open(QIODevice::WriteOnly|QIODevice::Append)) {
+        qWarning() << "Failed to open archive index" << index.fileName() << index.errorString();
+        return false;
+    }
+    QJsonArray headers;
+    for (const QPair<QByteArray, QByteArray> &header: response.headers) {
+        headers.append(QJsonArray{ QString::fromLatin1(header.first),
+                                   QString::fromLatin1(header.second) });
+    }
+    QJsonObject entry {
+        { QStringLiteral("key"), QString::fromLatin1(entryKey) },
+        { QStringLiteral("method"), QString::fromLatin1(method) },
+        { QStringLiteral("url"), url.toString() },
+        { QStringLiteral("requestSize"), requestBody.size() },
+        { QStringLiteral("status"), response.status },
+        { QStringLiteral("mimeType"), QString::fromLatin1(response.mimeType) },
+        { QStringLiteral("headers"), headers },
+        { QStringLiteral("size"), response.body.size() },
+    };
+    if (response.location.isValid()) {
+        entry.insert(QStringLiteral("location"), response.location.toString());
+    }
+    index.write(QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n');
+    entries.insert(entryKey, entry);
+    qDebug() << "Recorded" << method << url.toString() << response.status
+             << response.body.size() << "bytes";
+    return true;
+}
+
+/*!
+ * Returns the archive scheme URL that stands in for the (https) \a url.
+ */
+QUrl WebArchive::archiveUrl(const QUrl &url)
+{
+    QUrl archiveUrl(url);
+    archiveUrl.setScheme(QString::fromLatin1(ARCHIVE_SCHEME));
+    return archiveUrl;
+}
+
+/*!
+ * Returns \c true if \a url carries its request's body, for the archive.
+ */
+bool WebArchive::hasRequestBody(const QUrl &url)
+{
+    for (const QByteArray &item: url.query(QUrl::FullyEncoded).toLatin1().split('&')) {
+        if (item.startsWith(ARCHIVE_BODY_ITEM + '=')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*!
+ * Returns the original (https) URL that the archive scheme \a url stands in for.
+ */
+QUrl WebArchive::originalUrl(const QUrl &url)
+{
+    QUrl originalUrl(url);
+    originalUrl.setScheme(QStringLiteral("https"));
+    return originalUrl;
+}
+
+/*!
+ * Register the archive URL scheme. This must be called before the QApplication is constructed.
+ */
+void WebArchive::registerScheme()
+{
+    QWebEngineUrlScheme scheme(ARCHIVE_SCHEME);
+    scheme.setSyntax(QWebEngineUrlScheme::Syntax::HostAndPort);
+    scheme.setDefaultPort(443);
+    scheme.setFlags(QWebEngineUrlScheme::SecureScheme | QWebEngineUrlScheme::CorsEnabled |
+                    QWebEngineUrlScheme::FetchApiAllowed);
+    QWebEngineUrlScheme::registerScheme(scheme);
+}
+
+/*!
+ * Returns \a url without the query items that carry its request's body to the archive (as added by
+ * the archive's page script), setting \a body and \a contentType to the request's, and \a method
+ * to any overriding method. A \a url without such items is returned unchanged.
+ */
+QUrl WebArchive::takeRequestBody(const QUrl &url, QByteArray &method, QByteArray &body,
+                                 QByteArray &contentType)
+{
+    if (!hasRequestBody(url)) {
+        return url;
+    }
+    QByteArrayList items;
+    for (const QByteArray &item: url.query(QUrl::FullyEncoded).toLatin1().split('&')) {
+        const int equals = item.indexOf('=');
+        const QByteArray name = item.left(equals);
+        const QByteArray value = QByteArray::fromPercentEncoding(item.mid(equals + 1));
+        if (name == ARCHIVE_BODY_ITEM) {
+            body = QByteArray::fromBase64(value);
+        } else if (name == ARCHIVE_METHOD_ITEM) {
+            method = value.toUpper();
+        } else if (name == ARCHIVE_TYPE_ITEM) {
+            contentType = value;
+        } else {
+            items.append(item);
+        }
+    }
+    QUrl stripped(url);
+    stripped.setQuery(items.isEmpty() ? QString() : QString::fromLatin1(items.join('&')),
+                      QUrl::StrictMode);
+    return stripped;
+}
+
+QByteArray WebArchive::key(const QByteArray &method, const QUrl &url, const QByteArray &body)
+{
+    // Entries are keyed on the original URL, so recordings and replays are interchangeable. Those
+    // without request bodies keep the keys they had before bodies were recorded.
+    QByteArray request = method + ' ' + originalUrl(url).toEncoded();
+    if (!body.isEmpty()) {
+        request += ' ' + QCryptographicHash::hash(body, QCryptographicHash::Sha1).toHex();
+    }
+    return QCryptographicHash::hash(request, QCryptographicHash::Sha1).toHex();
+}
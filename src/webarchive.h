@@ -0,0 +1,84 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WEBARCHIVE_H
+#define WEBARCHIVE_H
+
+#include <QByteArray>
+#include <QDir>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+#include <QUrl>
+
+#define ARCHIVE_SCHEME QByteArrayLiteral("float-archive")
+
+// Query items that carry a request's body (base64 encoded), content type, and (for form
+// submissions, which navigate via GET) method to the archive; see WebArchive::takeRequestBody().
+#define ARCHIVE_BODY_ITEM QByteArrayLiteral("float-archive-body")
+#define ARCHIVE_METHOD_ITEM QByteArrayLiteral("float-archive-method")
+#define ARCHIVE_TYPE_ITEM QByteArrayLiteral("float-archive-type")
+
+class WebArchive
+{
+
+public:
+    enum class Mode {
+        Record,
+        Replay,
+    };
+
+    struct Response {
+        int status;              // HTTP status code.
+        QByteArray mimeType;
+        QUrl location;           // Redirect target (absolute), if any.
+        QList<QPair<QByteArray, QByteArray>> headers;
+        QByteArray body;
+        Response() : status(200) { }
+    };
+
+    WebArchive(const QString &dirName, const Mode mode);
+
+    Mode mode() const;
+    bool open();
+
+    bool load(const QByteArray &method, const QUrl &url, const QByteArray &requestBody,
+              Response &response) const;
+    bool store(const QByteArray &method, const QUrl &url, const QByteArray &requestBody,
+               const Response &response);
+
+    static QUrl archiveUrl(const QUrl &url);
+    static bool hasRequestBody(const QUrl &url);
+    static QUrl originalUrl(const QUrl &url);
+    static void registerScheme();
+    static QUrl takeRequestBody(const QUrl &url, QByteArray &method, QByteArray &body,
+                                QByteArray &contentType);
+
+protected:
+    static QByteArray key(const QByteArray &method, const QUrl &url, const QByteArray &body);
+
+private:
+    QDir dir;
+    const Mode archiveMode;
+    QHash<QByteArray, QJsonObject> entries; // Entry key -> index entry.
+
+};
+
+#endif // WEBARCHIVE_H
@@ -0,0 +1,259 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMessageAuthenticationCode>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrlQuery>
+
+#include <algorithm>
+
+#include "webhookreceiver.h"
+
+// Limits on (untrusted) requests.
+#define MAX_REQUEST_BYTES (64 * 1024)
+#define REQUEST_TIMEOUT_MSECS 10000
+
+/*!
+ * Constructs a receiver for Fitbit subscription notifications about \a accounts. Notifications are
+ * verified against the \a clientSecret, and subscriber verification requests against the
+ * \a verificationCode.
+ */
+WebhookReceiver::WebhookReceiver(const QList<Account> &accounts, const QByteArray &clientSecret,
+                                 const QString &verificationCode, QObject * parent)
+    : QObject(parent), accounts(accounts), clientSecret(clientSecret),
+      verificationCode(verificationCode), debounceMsecs(5000)
+{
+    connect(&server, &QTcpServer::newConnection, this, &WebhookReceiver::onNewConnection);
+}
+
+WebhookReceiver::~WebhookReceiver()
+{
+
+}
+
+/*!
+ * Begin listening for notifications on the local (loopback) \a port. Expose it to Fitbit via a
+ * reverse proxy (which terminates TLS) rather than directly.
+ */
+bool WebhookReceiver::listen(const quint16 port)
+{
+    if (!server.listen(QHostAddress::LocalHost, port)) {
+        qCritical().noquote() << "Failed to listen on port" << port << server.errorString();
+        return false;
+    }
+    qInfo().noquote() << "Listening for Fitbit notifications on port" << server.serverPort();
+    return true;
+}
+
+/*!
+ * Returns the port being listened on (eg, the one chosen if listen() was given port 0).
+ */
+quint16 WebhookReceiver::serverPort() const
+{
+    return server.serverPort();
+}
+
+/*!
+ * Wait until an account's notifications have been quiet for \a msecs before syncing it, so that
+ * bursts of notifications (Fitbit sends one per change, and retries) result in a single sync.
+ */
+void WebhookReceiver::setDebounce(const int msecs)
+{
+    debounceMsecs = msecs;
+}
+
+/*!
+ * Returns the (base64 encoded) signature Fitbit sends with notification \a body, which is the
+ * HMAC-SHA1 of the body, keyed by the \a clientSecret with an "&" appended.
+ */
+QByteArray WebhookReceiver::signature(const QByteArray &body, const QByteArray &clientSecret)
+{
+    return QMessageAuthenticationCode::hash(body, clientSecret + '&', QCryptographicHash::Sha1)
+        .toBase64();
+}
+
+// Protected Methods
+
+/*!
+ * Request a (debounced) sync of each account that the \a notifications are about.
+ */
+void WebhookReceiver::handleNotifications(const QJsonArray &notifications)
+{
+    for (const QJsonValue &value: notifications) {
+        const QJsonObject notification = value.toObject();
+        const QString collection = notification.value(QLatin1String("collectionType")).toString();
+        if ((collection != QLatin1String("body")) && (!collection.isEmpty())) {
+            qDebug().noquote() << "Ignoring" << collection << "notification";
+            continue; // Not a weight (or body fat) change.
+        }
+
+        // Match by Fitbit user ID, else by subscription ID (as the account's name).
+        const QString ownerId = notification.value(QLatin1String("ownerId")).toString();
+        const QString subscriptionId =
+            notification.value(QLatin1String("subscriptionId")).toString();
+        const auto account = std::find_if(accounts.constBegin(), accounts.constEnd(),
+            [&ownerId, &subscriptionId](const Account &account) {
+                return ((!account.fitbitUserId.isEmpty()) && (account.fitbitUserId == ownerId)) ||
+                       (account.name == subscriptionId) ||
+                       (QFileInfo(account.name).completeBaseName() == subscriptionId);
+            });
+        if (account == accounts.constEnd()) {
+            qWarning().noquote() << "Ignoring notification for unknown owner" << ownerId
+                                 << "subscription" << subscriptionId;
+            continue;
+        }
+
+        // (Re)start the account's debounce timer, so a burst of notifications triggers one sync.
+        QTimer * &timer = debouncers[account->name];
+        if (!timer) {
+            timer = new QTimer(this);
+            timer->setSingleShot(true);
+            const QString name = account->name;
+            connect(timer, &QTimer::timeout, this, [this, name]() {
+                qInfo().noquote() << "Requesting sync of" << name << "after notification";
+                emit syncRequested(name, true);
+            });
+        } else if (timer->isActive()) {
+            qDebug().noquote() << "Coalescing notification for" << account->name;
+        }
+        timer->start(debounceMsecs);
+    }
+}
+
+/*!
+ * Handle a complete HTTP request from \a socket.
+ */
+void WebhookReceiver::handleRequest(QTcpSocket * socket, const QByteArray &method, const QUrl &url,
+                                    const QMap<QByteArray, QByteArray> &headers,
+                                    const QByteArray &body)
+{
+    // Subscriber verification: 204 if the code is correct, 404 otherwise.
+    if (method == "GET") {
+        const QUrlQuery query(url);
+        if (!query.hasQueryItem(QStringLiteral("verify"))) {
+            respond(socket, 404, "Not Found");
+        } else if ((!verificationCode.isEmpty()) &&
+                   (query.queryItemValue(QStringLiteral("verify")) == verificationCode)) {
+            qInfo() << "Verified subscriber endpoint";
+            respond(socket, 204, "No Content");
+        } else {
+            qWarning() << "Rejected subscriber verification with incorrect code";
+            respond(socket, 404, "Not Found");
+        }
+        return;
+    }
+
+    if (method != "POST") {
+        respond(socket, 405, "Method Not Allowed");
+        return;
+    }
+
+    // Notifications: 204 if the signature is valid, 404 otherwise (as Fitbit expects).
+    const QByteArray expected = signature(body, clientSecret);
+    const QByteArray actual = headers.value("x-fitbit-signature");
+    char difference = (actual.size() == expected.size()) ? 0 : 1;
+    for (int index = 0; (index < actual.size()) && (index < expected.size()); ++index) {
+        difference |= (actual.at(index) ^ expected.at(index)); // Constant time comparison.
+    }
+    if (difference != 0) {
+        qWarning() << "Rejected notification with invalid signature";
+        respond(socket, 404, "Not Found");
+        return;
+    }
+    respond(socket, 204, "No Content"); // Respond promptly; the sync happens afterwards.
+
+    QJsonParseError error;
+    const QJsonDocument document = QJsonDocument::fromJson(body, &error);
+    if (!document.isArray()) {
+        qWarning().noquote() << "Failed to parse notifications" << error.errorString();
+        return;
+    }
+    handleNotifications(document.array());
+}
+
+void WebhookReceiver::respond(QTcpSocket * socket, const int status, const QByteArray &reason)
+{
+    disconnect(socket, &QTcpSocket::readyRead, Q_NULLPTR, Q_NULLPTR); // One request per connection.
+    socket->readAll(); // Discard any unread request, so closing doesn't reset the connection.
+    socket->write("HTTP/1.1 " + QByteArray::number(status) + ' ' + reason + "\r\n"
+                  "Content-Length: 0\r\n"
+                  "Connection: close\r\n\r\n");
+    socket->disconnectFromHost();
+}
+
+// Protected Slots
+
+void WebhookReceiver::onNewConnection()
+{
+    while (QTcpSocket * const socket = server.nextPendingConnection()) {
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { readRequest(socket); });
+        connect(socket, &QTcpSocket::disconnected, socket, &QTcpSocket::deleteLater);
+        QTimer::singleShot(REQUEST_TIMEOUT_MSECS, socket, [socket]() { socket->abort(); });
+    }
+}
+
+/*!
+ * Read the request from \a socket, once it has arrived in full.
+ */
+void WebhookReceiver::readRequest(QTcpSocket * socket)
+{
+    const QByteArray data = socket->peek(socket->bytesAvailable());
+    if (data.size() > MAX_REQUEST_BYTES) {
+        respond(socket, 413, "Payload Too Large");
+        return;
+    }
+    const int headerEnd = data.indexOf("\r\n\r\n");
+    if (headerEnd < 0) {
+        return; // Wait for the rest of the headers.
+    }
+
+    // Parse the request line, and headers (with names lower-cased).
+    const QList<QByteArray> lines = data.left(headerEnd).split('\n');
+    const QList<QByteArray> requestLine = lines.first().trimmed().split(' ');
+    if (requestLine.size() != 3) {
+        respond(socket, 400, "Bad Request");
+        return;
+    }
+    QMap<QByteArray, QByteArray> headers;
+    for (int index = 1; index < lines.size(); ++index) {
+        const int colon = lines.at(index).indexOf(':');
+        if (colon > 0) {
+            headers.insert(lines.at(index).left(colon).trimmed().toLower(),
+                           lines.at(index).mid(colon + 1).trimmed());
+        }
+    }
+
+    // Wait for the rest of the body.
+    const int contentLength = headers.value("content-length", "0").toInt();
+    if ((contentLength < 0) || (contentLength > MAX_REQUEST_BYTES)) {
+        respond(socket, 400, "Bad Request");
+        return;
+    }
+    if (data.size() < headerEnd + 4 + contentLength) {
+        return;
+    }
+    socket->readAll();
+    handleRequest(socket, requestLine.at(0), QUrl(QString::fromLatin1(requestLine.at(1))), headers,
+                  data.mid(headerEnd + 4, contentLength));
+}
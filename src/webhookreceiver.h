@@ -0,0 +1,73 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WEBHOOKRECEIVER_H
+#define WEBHOOKRECEIVER_H
+
+#include <QByteArray>
+#include <QJsonArray>
+#include <QList>
+#include <QMap>
+#include <QObject>
+#include <QTcpServer>
+
+#include "account.h"
+
+class QTcpSocket;
+class QTimer;
+
+class WebhookReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    WebhookReceiver(const QList<Account> &accounts, const QByteArray &clientSecret,
+                    const QString &verificationCode, QObject * parent = Q_NULLPTR);
+    virtual ~WebhookReceiver();
+
+    bool listen(const quint16 port);
+    quint16 serverPort() const;
+    void setDebounce(const int msecs);
+
+    static QByteArray signature(const QByteArray &body, const QByteArray &clientSecret);
+
+protected:
+    void handleNotifications(const QJsonArray &notifications);
+    void handleRequest(QTcpSocket * socket, const QByteArray &method, const QUrl &url,
+                       const QMap<QByteArray, QByteArray> &headers, const QByteArray &body);
+    static void respond(QTcpSocket * socket, const int status, const QByteArray &reason);
+
+protected slots:
+    void onNewConnection();
+    void readRequest(QTcpSocket * socket);
+
+private:
+    QTcpServer server;
+    const QList<Account> accounts;
+    const QByteArray clientSecret;
+    const QString verificationCode;
+    int debounceMsecs;
+    QMap<QString, QTimer *> debouncers; // Account name -> pending sync request.
+
+signals:
+    void syncRequested(const QString &account, const bool fresh);
+
+};
+
+#endif // WEBHOOKRECEIVER_H
@@ -0,0 +1,114 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include "worker.h"
+
+/*!
+ * Construct a worker that syncs \a accounts (one at a time), reporting each account's result to
+ * the coordinator listening on the \a serverName local socket.
+ */
+Worker::Worker(const QString &serverName, const QList<Account> &accounts,
+               const SyncJob::Options &options, QObject * parent)
+    : QObject(parent), serverName(serverName), pending(accounts), options(options),
+      job(Q_NULLPTR), exitCode(EXIT_SUCCESS), isFinished(false)
+{
+    connect(&socket, &QLocalSocket::connected, this, [this]() {
+        // Identify ourselves, so the coordinator can match this connection to our process.
+        const QJsonObject hello { { QStringLiteral("pid"), QCoreApplication::applicationPid() } };
+        socket.write(QJsonDocument(hello).toJson(QJsonDocument::Compact) + '\n');
+        nextJob();
+    });
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    connect(&socket, &QLocalSocket::errorOccurred,
+#else
+    connect(&socket, static_cast<void(QLocalSocket::*)(QLocalSocket::LocalSocketError)>
+            (&QLocalSocket::error),
+#endif
+            this, [this](const QLocalSocket::LocalSocketError error) {
+        // Ignore errors once finished, such as the coordinator closing its end as we disconnect.
+        if (!isFinished) {
+            qCritical().noquote() << "Worker socket error" << error << socket.errorString();
+            isFinished = true;
+            emit finished(EXIT_FAILURE);
+        }
+    });
+}
+
+Worker::~Worker()
+{
+
+}
+
+// Public Slots
+
+void Worker::start()
+{
+    qDebug() << "Worker" << QCoreApplication::applicationPid() << "connecting to" << serverName;
+    socket.connectToServer(serverName);
+}
+
+// Protected Slots
+
+void Worker::nextJob()
+{
+    if (isFinished) {
+        return;
+    }
+
+    if (pending.isEmpty()) {
+        isFinished = true;
+        socket.disconnectFromServer();
+        if (socket.state() != QLocalSocket::UnconnectedState) {
+            socket.waitForDisconnected();
+        }
+        emit finished(exitCode);
+        return;
+    }
+
+    job = new SyncJob(pending.takeFirst(), options, this);
+    connect(job, &SyncJob::finished, this, &Worker::onJobFinished);
+    job->start();
+}
+
+void Worker::onJobFinished(const int exitCode)
+{
+    Q_ASSERT(job);
+    if (exitCode != EXIT_SUCCESS) {
+        this->exitCode = exitCode;
+    }
+
+    // Report the account's result to the coordinator, one JSON object per line.
+    const QJsonObject result {
+        { QStringLiteral("account"), job->account().name },
+        { QStringLiteral("exitCode"), exitCode },
+        { QStringLiteral("summary"), job->summary().toJson() },
+    };
+    socket.write(QJsonDocument(result).toJson(QJsonDocument::Compact) + '\n');
+    socket.flush();
+
+    // Release this job's web pages (and renderer processes) before starting the next one.
+    job->deleteLater();
+    job = Q_NULLPTR;
+    QMetaObject::invokeMethod(this, "nextJob", Qt::QueuedConnection);
+}
@@ -0,0 +1,60 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WORKER_H
+#define WORKER_H
+
+#include <QList>
+#include <QLocalSocket>
+#include <QObject>
+
+#include "account.h"
+#include "syncjob.h"
+
+class Worker : public QObject
+{
+    Q_OBJECT
+
+public:
+    Worker(const QString &serverName, const QList<Account> &accounts,
+           const SyncJob::Options &options, QObject * parent = Q_NULLPTR);
+    virtual ~Worker();
+
+public slots:
+    void start();
+
+protected slots:
+    void nextJob();
+    void onJobFinished(const int exitCode);
+
+private:
+    const QString serverName;
+    QList<Account> pending;
+    const SyncJob::Options options;
+    QLocalSocket socket;
+    SyncJob * job;
+    int exitCode;
+    bool isFinished;
+
+signals:
+    void finished(const int exitCode);
+
+};
+
+#endif // WORKER_H
@@ -0,0 +1,227 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QLockFile>
+#include <QSaveFile>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+#include "writejournal.h"
+
+// Rewrite the journal with just its pending entries, once it has grown to this many lines.
+#define COMPACT_THRESHOLD_LINES 256
+
+/*!
+ * Constructs a journal of pending writes, appended to the \a fileName JSON Lines file. The file is
+ * locked while it is read or written, so multiple (worker) processes may safely share it. If
+ * \a fileName is empty, the journal is kept in memory only.
+ */
+WriteJournal::WriteJournal(const QString &fileName) : journalFileName(fileName)
+{
+
+}
+
+QString WriteJournal::fileName() const
+{
+    return journalFileName;
+}
+
+/*!
+ * Returns \a account's pending writes, oldest measurement first.
+ */
+QList<WriteJournal::Entry> WriteJournal::pending(const QString &account) const
+{
+    return replay().value(account).values();
+}
+
+/*!
+ * Durably records \a entry as pending, replacing any pending entry for the same measurement.
+ */
+bool WriteJournal::append(const Entry &entry)
+{
+    QJsonObject line = toJson(entry);
+    line.insert(QStringLiteral("op"), QStringLiteral("pending"));
+    return appendLine(line);
+}
+
+/*!
+ * Durably records that the \a account's \a measurement was written. This resolves that entry, and
+ * any older ones for the same account, since they've been superseded.
+ */
+bool WriteJournal::markWritten(const QString &account, const QString &measurement)
+{
+    return appendLine({
+        { QStringLiteral("op"), QStringLiteral("written") },
+        { QStringLiteral("account"), account },
+        { QStringLiteral("measurement"), measurement },
+    });
+}
+
+// Protected Methods
+
+/*!
+ * Appends \a line to the journal, and syncs it to disk before returning. The journal is compacted
+ * afterwards, if it has grown large enough.
+ */
+bool WriteJournal::appendLine(const QJsonObject &line)
+{
+    QJsonObject timestamped(line);
+    timestamped.insert(QStringLiteral("time"),
+                       QDateTime::currentDateTimeUtc().toString(Qt::ISODateWithMs));
+    if (journalFileName.isEmpty()) {
+        memoryLines.append(timestamped);
+        return true;
+    }
+
+    QLockFile lock(journalFileName + QStringLiteral(".lock"));
+    if (!lock.lock()) {
+        qWarning() << "Failed to lock" << journalFileName << lock.error();
+        return false;
+    }
+
+    QFile file(journalFileName);
+    if (!file.open(QIODevice::ReadWrite|QIODevice::Append|QIODevice::Unbuffered)) {
+        qWarning() << "Failed to open" << journalFileName << file.errorString();
+        return false;
+    }
+    QByteArray bytes = QJsonDocument(timestamped).toJson(QJsonDocument::Compact) + '\n';
+
+    // Terminate any torn final line (eg from a crash mid-write), so it can't corrupt this one.
+    if ((file.size() > 0) && (file.seek(file.size() - 1)) && (file.read(1) != "\n")) {
+        bytes.prepend('\n');
+    }
+    if ((file.write(bytes) != bytes.size()) || (!file.flush())) {
+        qWarning() << "Failed to write to" << journalFileName << file.errorString();
+        return false;
+    }
+#ifdef Q_OS_UNIX
+    const bool synced = (::fsync(file.handle()) == 0);
+#elif defined(Q_OS_WIN)
+    const bool synced = (::_commit(file.handle()) == 0);
+#else
+    const bool synced = true;
+#endif
+    if (!synced) {
+        qWarning() << "Failed to sync" << journalFileName;
+        return false;
+    }
+    file.close();
+
+    int lineCount = 0;
+    const QMap<QString, QMap<QString, Entry>> entries = replay(&lineCount);
+    if (lineCount >= COMPACT_THRESHOLD_LINES) {
+        compact(entries);
+    }
+    return true;
+}
+
+/*!
+ * Atomically replaces the journal with just the pending \a entries. The caller must hold the lock.
+ */
+bool WriteJournal::compact(const QMap<QString, QMap<QString, Entry>> &entries)
+{
+    QSaveFile file(journalFileName);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open" << journalFileName << file.errorString();
+        return false;
+    }
+    for (const QMap<QString, Entry> &accountEntries: entries) {
+        for (const Entry &entry: accountEntries) {
+            QJsonObject line = toJson(entry);
+            line.insert(QStringLiteral("op"), QStringLiteral("pending"));
+            file.write(QJsonDocument(line).toJson(QJsonDocument::Compact) + '\n');
+        }
+    }
+    if (!file.commit()) { // Syncs to disk before renaming over the original.
+        qWarning() << "Failed to compact" << journalFileName << file.errorString();
+        return false;
+    }
+    qDebug() << "Compacted" << journalFileName;
+    return true;
+}
+
+/*!
+ * Replays the journal, returning the pending entries (account -> measurement -> entry), and setting
+ * \a lineCount (if not null) to the number of lines replayed. Incomplete or corrupt lines (such as
+ * a final line torn by a crash) are skipped.
+ */
+QMap<QString, QMap<QString, WriteJournal::Entry>> WriteJournal::replay(int * lineCount) const
+{
+    QList<QJsonObject> lines = memoryLines;
+    if (!journalFileName.isEmpty()) {
+        QFile file(journalFileName);
+        if (file.open(QIODevice::ReadOnly)) {
+            while (!file.atEnd()) {
+                const QByteArray line = file.readLine().trimmed();
+                const QJsonDocument document = QJsonDocument::fromJson(line);
+                if (document.isObject()) {
+                    lines.append(document.object());
+                } else if (!line.isEmpty()) {
+                    qWarning() << "Skipping corrupt journal line" << line;
+                }
+            }
+        }
+    }
+    if (lineCount) {
+        *lineCount = lines.size();
+    }
+
+    QMap<QString, QMap<QString, Entry>> entries;
+    for (const QJsonObject &line: lines) {
+        const QString op = line.value(QLatin1String("op")).toString();
+        const QString account = line.value(QLatin1String("account")).toString();
+        const QString measurement = line.value(QLatin1String("measurement")).toString();
+        QMap<QString, Entry> &accountEntries = entries[account];
+        if (op == QLatin1String("pending")) {
+            Entry entry;
+            entry.account = account;
+            entry.measurement = measurement;
+            entry.mass = line.value(QLatin1String("mass")).toDouble();
+            entry.queued = QDateTime::fromString(line.value(QLatin1String("queued")).toString(),
+                                                 Qt::ISODateWithMs);
+            accountEntries.insert(measurement, entry);
+        } else if (op == QLatin1String("written")) {
+            // Measurement IDs are ISO dates, so sort chronologically.
+            while ((!accountEntries.isEmpty()) && (accountEntries.firstKey() <= measurement)) {
+                accountEntries.erase(accountEntries.begin());
+            }
+        }
+        if (accountEntries.isEmpty()) {
+            entries.remove(account);
+        }
+    }
+    return entries;
+}
+
+QJsonObject WriteJournal::toJson(const Entry &entry)
+{
+    return {
+        { QStringLiteral("account"), entry.account },
+        { QStringLiteral("measurement"), entry.measurement },
+        { QStringLiteral("mass"), entry.mass },
+        { QStringLiteral("queued"), entry.queued.toUTC().toString(Qt::ISODateWithMs) },
+    };
+}
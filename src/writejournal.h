@@ -0,0 +1,61 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WRITEJOURNAL_H
+#define WRITEJOURNAL_H
+
+#include <QDateTime>
+#include <QJsonObject>
+#include <QList>
+#include <QMap>
+#include <QString>
+
+class WriteJournal
+{
+
+public:
+    struct Entry {
+        QString account;     // Sink (Polar) username.
+        QString measurement; // Measurement ID.
+        double mass;
+        QDateTime queued;
+        Entry() : mass(0) { }
+    };
+
+    explicit WriteJournal(const QString &fileName);
+
+    QString fileName() const;
+    QList<Entry> pending(const QString &account) const;
+
+    bool append(const Entry &entry);
+    bool markWritten(const QString &account, const QString &measurement);
+
+protected:
+    bool appendLine(const QJsonObject &line);
+    bool compact(const QMap<QString, QMap<QString, Entry>> &entries);
+    QMap<QString, QMap<QString, Entry>> replay(int * lineCount = Q_NULLPTR) const;
+    static QJsonObject toJson(const Entry &entry);
+
+private:
+    QString journalFileName;
+    QList<QJsonObject> memoryLines; // Used instead of a file, if journalFileName is empty.
+
+};
+
+#endif // WRITEJOURNAL_H
@@ -0,0 +1,106 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QSettings>
+
+#include <cmath>
+
+#include "writerecord.h"
+
+/*!
+ * Load the record (if any) stored under \a group in the \a fileName state file.
+ */
+WriteRecord::WriteRecord(const QString &fileName, const QString &group)
+    : fileName(fileName), group(group), lastMass(0)
+{
+    if (fileName.isEmpty()) {
+        return; // Persistence disabled.
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    settings.beginGroup(group);
+    lastMass = settings.value(QStringLiteral("mass"), 0.0).toDouble();
+    lastSourceId = settings.value(QStringLiteral("source")).toString();
+    lastTimestamp = settings.value(QStringLiteral("timestamp")).toDateTime();
+}
+
+bool WriteRecord::isValid() const
+{
+    return ((lastMass > 0) && (lastTimestamp.isValid()));
+}
+
+double WriteRecord::mass() const
+{
+    return lastMass;
+}
+
+QString WriteRecord::sourceId() const
+{
+    return lastSourceId;
+}
+
+QDateTime WriteRecord::timestamp() const
+{
+    return lastTimestamp;
+}
+
+/*!
+ * Returns \c true if \a mass matches the record (within \a tolerance), and the record is not older
+ * than \a maxAgeSecs. That is, if there's no need to write \a mass again.
+ */
+bool WriteRecord::isCurrent(const double mass, const double tolerance,
+                            const qint64 maxAgeSecs) const
+{
+    return ((matches(mass, tolerance)) && (!isStale(maxAgeSecs)));
+}
+
+/*!
+ * Returns \c true if the record is older than \a maxAgeSecs, and should therefore be verified
+ * against the remote value again. A \a maxAgeSecs of zero, or less, disables periodic verification.
+ */
+bool WriteRecord::isStale(const qint64 maxAgeSecs) const
+{
+    return ((maxAgeSecs > 0) &&
+            (lastTimestamp.secsTo(QDateTime::currentDateTimeUtc()) > maxAgeSecs));
+}
+
+bool WriteRecord::matches(const double mass, const double tolerance) const
+{
+    return ((isValid()) && (std::fabs(mass - lastMass) <= tolerance));
+}
+
+void WriteRecord::save(const double mass, const QString &sourceId)
+{
+    lastMass = mass;
+    lastSourceId = sourceId;
+    lastTimestamp = QDateTime::currentDateTimeUtc();
+    if (fileName.isEmpty()) {
+        return;
+    }
+    QSettings settings(fileName, QSettings::IniFormat);
+    settings.beginGroup(group);
+    settings.setValue(QStringLiteral("mass"), lastMass);
+    settings.setValue(QStringLiteral("source"), lastSourceId);
+    settings.setValue(QStringLiteral("timestamp"), lastTimestamp);
+    settings.endGroup();
+    settings.sync();
+    if (settings.status() != QSettings::NoError) {
+        qWarning() << "Failed to save write record to" << fileName << settings.status();
+    }
+}
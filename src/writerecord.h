@@ -0,0 +1,52 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#ifndef WRITERECORD_H
+#define WRITERECORD_H
+
+#include <QDateTime>
+#include <QString>
+
+class WriteRecord
+{
+
+public:
+    WriteRecord(const QString &fileName, const QString &group);
+
+    bool isValid() const;
+    double mass() const;
+    QString sourceId() const;
+    QDateTime timestamp() const;
+
+    bool isCurrent(const double mass, const double tolerance, const qint64 maxAgeSecs) const;
+    bool isStale(const qint64 maxAgeSecs) const;
+    bool matches(const double mass, const double tolerance) const;
+
+    void save(const double mass, const QString &sourceId);
+
+private:
+    QString fileName;
+    QString group;
+    double lastMass;
+    QString lastSourceId;
+    QDateTime lastTimestamp;
+
+};
+
+#endif // WRITERECORD_H
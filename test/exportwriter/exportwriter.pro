@@ -0,0 +1,13 @@
+include(../test.pri)
+
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/exportwriter.h \
+  ../../src/synchistory.h \
+
+SOURCES += \
+  ../../src/exportwriter.cpp \
+  ../../src/synchistory.cpp \
@@ -0,0 +1,203 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <QBuffer>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QTest>
+
+#include "exportwriter.h"
+
+Q_DECLARE_METATYPE(ExportWriter::Format)
+
+class TestExportWriter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void csvField_data();
+    void csvField();
+    void csvNumbers();
+    void jsonLines();
+    void chunks();
+    void failure();
+    void parseFormat_data();
+    void parseFormat();
+
+private:
+    static SyncHistory::Entry entry(const int day);
+
+};
+
+void TestExportWriter::csvField_data()
+{
+    QTest::addColumn<QString>("account");
+    QTest::addColumn<QByteArray>("field");
+
+    QTest::newRow("plain") << QStringLiteral("alice") << QByteArray("alice");
+    QTest::newRow("empty") << QString() << QByteArray();
+    QTest::newRow("space") << QStringLiteral("alice smith") << QByteArray("alice smith");
+    QTest::newRow("comma") << QStringLiteral("smith, alice") << QByteArray("\"smith, alice\"");
+    QTest::newRow("quote") << QStringLiteral("al\"ice\"") << QByteArray("\"al\"\"ice\"\"\"");
+    QTest::newRow("LF") << QStringLiteral("al\nice") << QByteArray("\"al\nice\"");
+    QTest::newRow("CR") << QStringLiteral("al\rice") << QByteArray("\"al\rice\"");
+    QTest::newRow("UTF-8") << QString::fromUtf8("zo\xc3\xab") << QByteArray("zo\xc3\xab");
+}
+
+/*!
+ * Text fields are written as UTF-8, quoted (per RFC 4180) only when they need to be.
+ */
+void TestExportWriter::csvField()
+{
+    QFETCH(QString, account);
+    QFETCH(QByteArray, field);
+
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    SyncHistory::Entry named = entry(1);
+    named.account = account;
+    {
+        ExportWriter writer(&buffer, ExportWriter::Format::Csv);
+        QVERIFY(writer.write(named));
+        QVERIFY(writer.flush());
+        QCOMPARE(writer.count(), Q_INT64_C(1));
+    }
+    QCOMPARE(buffer.data(), QByteArray("time,account,date,weight,bodyFat,written,source,status\n"
+                                       "2019-01-01T07:01:00.000Z,") + field +
+                            QByteArray(",2019-01-01T07:00:00Z,75.1,,,fitbit,synced\n"));
+}
+
+/*!
+ * Numbers are written as reported, or as empty fields if not known.
+ */
+void TestExportWriter::csvNumbers()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    SyncHistory::Entry measured = entry(2);
+    measured.measurement.weight = 75.123f;
+    measured.measurement.bodyFat = 20.5f;
+    measured.written = 74.8712345;
+    {
+        ExportWriter writer(&buffer, ExportWriter::Format::Csv);
+        QVERIFY(writer.write(measured));
+    }
+    QCOMPARE(buffer.data().split('\n').value(1),
+             QByteArray("2019-01-02T07:01:00.000Z,alice,2019-01-02T07:00:00Z,75.12,20.5,74.8712345,"
+                        "fitbit,synced"));
+}
+
+/*!
+ * JSON Lines output matches the history's own format, one entry per line, without a header.
+ */
+void TestExportWriter::jsonLines()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    QByteArray expected;
+    {
+        ExportWriter writer(&buffer, ExportWriter::Format::JsonLines);
+        for (int day = 1; day <= 3; ++day) {
+            QVERIFY(writer.write(entry(day)));
+            expected += QJsonDocument(SyncHistory::toJson(entry(day)))
+                .toJson(QJsonDocument::Compact) + '\n';
+        }
+        QCOMPARE(writer.count(), Q_INT64_C(3));
+    }
+    QCOMPARE(buffer.data(), expected);
+}
+
+/*!
+ * Large exports are written to the device in chunks as they go, not all at the end, and are not
+ * truncated.
+ */
+void TestExportWriter::chunks()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::WriteOnly));
+    {
+        ExportWriter writer(&buffer, ExportWriter::Format::Csv);
+        for (int day = 1; day <= 5000; ++day) {
+            QVERIFY(writer.write(entry(day)));
+        }
+        QVERIFY(buffer.size() > 0);
+        QCOMPARE(writer.count(), Q_INT64_C(5000));
+    }
+    QCOMPARE(buffer.data().count('\n'), 5001);
+    QVERIFY(buffer.data().endsWith(",75.1,,,fitbit,synced\n"));
+}
+
+/*!
+ * A failure to write to the device is reported, and stays reported.
+ */
+void TestExportWriter::failure()
+{
+    QBuffer buffer;
+    QVERIFY(buffer.open(QIODevice::ReadOnly));
+    ExportWriter writer(&buffer, ExportWriter::Format::Csv);
+    QVERIFY(writer.write(entry(1)));
+    QVERIFY(!writer.flush());
+    QVERIFY(!writer.flush());
+}
+
+void TestExportWriter::parseFormat_data()
+{
+    QTest::addColumn<QString>("string");
+    QTest::addColumn<bool>("valid");
+    QTest::addColumn<ExportWriter::Format>("format");
+
+    QTest::newRow("csv") << QStringLiteral("csv") << true << ExportWriter::Format::Csv;
+    QTest::newRow("jsonl") << QStringLiteral("jsonl") << true << ExportWriter::Format::JsonLines;
+    QTest::newRow("CSV") << QStringLiteral("CSV") << false << ExportWriter::Format::Csv;
+    QTest::newRow("json") << QStringLiteral("json") << false << ExportWriter::Format::Csv;
+    QTest::newRow("empty") << QString() << false << ExportWriter::Format::Csv;
+}
+
+void TestExportWriter::parseFormat()
+{
+    QFETCH(QString, string);
+    QFETCH(bool, valid);
+    QFETCH(ExportWriter::Format, format);
+
+    ExportWriter::Format parsed = ExportWriter::Format::Csv;
+    QCOMPARE(ExportWriter::parseFormat(string, parsed), valid);
+    QCOMPARE(parsed, format); // Left untouched if not valid.
+}
+
+// Private Methods
+
+/*!
+ * Returns a synced entry for alice's 75.1kg measurement on the given \a day (of 2019).
+ */
+SyncHistory::Entry TestExportWriter::entry(const int day)
+{
+    SyncHistory::Entry entry;
+    entry.measurement.date = QDateTime(QDate(2019, 1, 1).addDays(day - 1), QTime(7, 0), Qt::UTC);
+    entry.measurement.weight = 75.1f;
+    entry.time = entry.measurement.date.addSecs(60);
+    entry.account = QStringLiteral("alice");
+    entry.source = QStringLiteral("fitbit");
+    entry.status = QStringLiteral("synced");
+    return entry;
+}
+
+QTEST_APPLESS_MAIN(TestExportWriter)
+
+#include "tst_exportwriter.moc"
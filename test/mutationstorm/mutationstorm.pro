@@ -0,0 +1,19 @@
+include(../test.pri)
+
+# Drive a real (offscreen) web engine page, which requires the GUI after all.
+QT += webenginewidgets
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/noninteractivewebpage.h \
+  ../../src/observablewebpage.h \
+  ../../src/resourcesampler.h \
+  ../../src/runsummary.h \
+
+SOURCES += \
+  ../../src/noninteractivewebpage.cpp \
+  ../../src/observablewebpage.cpp \
+  ../../src/resourcesampler.cpp \
+  ../../src/runsummary.cpp \
@@ -0,0 +1,242 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QRegularExpression>
+#include <QSignalSpy>
+#include <QTest>
+#include <QTimer>
+#include <QVector>
+
+#include <algorithm>
+
+#include "observablewebpage.h"
+#include "resourcesampler.h"
+
+// Event loop gaps longer than this (one frame at 60Hz) count as stalls.
+#define STALL_THRESHOLD_MSECS 16
+
+// Generates a storm of DOM mutations, at a controllable rate and payload size. Each event appends
+// an element, marks and clears its timestamp attribute (so the clearing record's old value carries
+// the time of the event), rewrites its text, and trims the oldest element once there are too many.
+// The page counts the records its own observer (with the same options) sees, so the harness can
+// check that none were lost.
+#define STORM_HTML QStringLiteral(R"HTML(<!DOCTYPE html>
+<html>
+<body>
+<div id="storm"></div>
+<script>
+    const storm = document.getElementById('storm');
+    const padding = 'x'.repeat(%1);
+    let records = 0;
+    new MutationObserver((mutationList) => {
+        records += mutationList.length;
+    }).observe(document.body, %2);
+
+    function startStorm(rate, durationMsecs) {
+        const start = performance.now();
+        const total = Math.floor(durationMsecs * rate / 1000);
+        let events = 0;
+        function tick() {
+            const elapsed = performance.now() - start;
+            const due = Math.min(Math.floor(elapsed * rate / 1000), total);
+            for (; events < due; ++events) {
+                const element = document.createElement('span');
+                element.textContent = padding;
+                storm.appendChild(element);
+                element.setAttribute('data-stamp', Date.now() + ':' + padding);
+                element.setAttribute('data-stamp', '');
+                element.firstChild.data = padding + events;
+                if (storm.childElementCount > 100) {
+                    storm.removeChild(storm.firstElementChild);
+                }
+            }
+            if (events < total) {
+                setTimeout(tick, 0);
+            } else {
+                // Report after this task's mutation records have all been delivered.
+                setTimeout(() => console.debug('%3' + JSON.stringify({ events, records })), 0);
+            }
+        }
+        tick();
+    }
+</script>
+</body>
+</html>
+)HTML")
+
+class TestMutationStorm : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void storm_data();
+    void storm();
+
+};
+
+void TestMutationStorm::initTestCase()
+{
+    // Log as the application does by default, since the per-record logging is part of the cost.
+    QLoggingCategory::setFilterRules(QStringLiteral("js=true\njs.info=false\n*.debug=false"));
+}
+
+void TestMutationStorm::storm_data()
+{
+    QTest::addColumn<int>("rate");         // Events per second.
+    QTest::addColumn<int>("payload");      // Bytes of text per attribute, and text node.
+    QTest::addColumn<int>("duration");     // Milliseconds to generate events for.
+    QTest::addColumn<QString>("options");  // MutationObserver options, as JSON.
+
+    const QString attributes = QStringLiteral(
+        R"({"attributes":true,"attributeOldValue":true,"subtree":true})");
+    QTest::newRow("attributes-1k/s-64B")  << 1000 << 64   << 2000 << attributes;
+    QTest::newRow("attributes-5k/s-64B")  << 5000 << 64   << 2000 << attributes;
+    QTest::newRow("attributes-1k/s-4KiB") << 1000 << 4096 << 2000 << attributes;
+    QTest::newRow("childList-1k/s-64B")   << 1000 << 64   << 2000
+        << QStringLiteral(R"({"childList":true,"subtree":true})");
+    QTest::newRow("all-1k/s-64B")         << 1000 << 64   << 2000
+        << QStringLiteral(R"({"childList":true,"attributes":true,"characterData":true,)"
+                          R"("subtree":true,"attributeOldValue":true,)"
+                          R"("characterDataOldValue":true})");
+}
+
+/*!
+ * Measures end-to-end records per second, signal latency percentiles, event loop stalls, and
+ * memory growth, while ObservableWebPage::observe relays a storm of mutations.
+ */
+void TestMutationStorm::storm()
+{
+    QFETCH(int, rate);
+    QFETCH(int, payload);
+    QFETCH(int, duration);
+    QFETCH(QString, options);
+
+    ObservableWebPage page;
+    QSignalSpy loadSpy(&page, &ObservableWebPage::loadFinished);
+    page.setHtml(STORM_HTML.arg(payload).arg(options, page.channelPrefix(QStringLiteral("storm"))),
+                 QUrl(QStringLiteral("http://localhost/")));
+    QVERIFY(loadSpy.wait(10000));
+    QVERIFY(loadSpy.first().first().toBool());
+
+    const qint64 browserPid = QCoreApplication::applicationPid();
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 15, 0))
+    const qint64 rendererPid = page.renderProcessPid();
+#else
+    const qint64 rendererPid = 0;
+#endif
+    const ResourceSampler::Sample browserBefore = ResourceSampler::sampleProcess(browserPid);
+    const ResourceSampler::Sample rendererBefore = ResourceSampler::sampleProcess(rendererPid);
+
+    // Record the receipt of each mutation, and the latency of those carrying a timestamp.
+    const QRegularExpression stampPattern(QStringLiteral("^(\\d+):"));
+    QElapsedTimer clock;
+    qint64 lastRecordMsecs = 0;
+    int received = 0;
+    QVector<qint64> latencies;
+    connect(&page, &ObservableWebPage::mutationObserved, this, [&](const QJsonObject &mutation) {
+        ++received;
+        lastRecordMsecs = clock.elapsed();
+        const QRegularExpressionMatch match =
+            stampPattern.match(mutation.value(QLatin1String("oldValue")).toString());
+        if (match.hasMatch()) {
+            latencies.append(QDateTime::currentMSecsSinceEpoch() - match.captured(1).toLongLong());
+        }
+    });
+
+    // Note the page's own count of records, once it has finished generating events.
+    int expected = -1;
+    connect(&page, &ObservableWebPage::channelMessage, this,
+            [&](const QString &channel, const QJsonValue &payload) {
+        if (channel == QLatin1String("storm")) {
+            expected = payload.toObject().value(QLatin1String("records")).toInt();
+        }
+    });
+
+    // Watch for event loop stalls, via the gaps between (nominally) 1ms timer events.
+    QElapsedTimer stallClock;
+    qint64 lastTickMsecs = 0, maxGapMsecs = 0, stallMsecs = 0;
+    QTimer ticker;
+    ticker.setTimerType(Qt::PreciseTimer);
+    ticker.setInterval(1);
+    connect(&ticker, &QTimer::timeout, this, [&]() {
+        const qint64 now = stallClock.elapsed();
+        const qint64 gap = now - lastTickMsecs;
+        lastTickMsecs = now;
+        maxGapMsecs = qMax(maxGapMsecs, gap);
+        if (gap > STALL_THRESHOLD_MSECS) {
+            stallMsecs += gap;
+        }
+    });
+
+    // Observe the page, and unleash the storm.
+    page.observe(QStringLiteral("document.body"), options);
+    clock.start();
+    stallClock.start();
+    ticker.start();
+    page.runJavaScript(QStringLiteral("startStorm(%1, %2)").arg(rate).arg(duration));
+    QTRY_VERIFY_WITH_TIMEOUT(expected >= 0, duration + 30000);
+    QTRY_COMPARE_WITH_TIMEOUT(received, expected, 30000);
+    ticker.stop();
+    QVERIFY(received > 0);
+
+    const ResourceSampler::Sample browserAfter = ResourceSampler::sampleProcess(browserPid);
+    const ResourceSampler::Sample rendererAfter = ResourceSampler::sampleProcess(rendererPid);
+
+    // Report the results.
+    std::sort(latencies.begin(), latencies.end());
+    const auto percentile = [&latencies](const int percent) -> qint64 {
+        return latencies.isEmpty() ? -1
+            : latencies.at(qMin(latencies.size() * percent / 100, latencies.size() - 1));
+    };
+    const double recordsPerSec = (lastRecordMsecs > 0) ? (received * 1000.0 / lastRecordMsecs) : 0;
+    qInfo().noquote() << QStringLiteral("%1 records in %2ms (%3/s); latency ms p50 %4 p90 %5 p99 %6"
+                                        " max %7; stalls %8ms (max gap %9ms)")
+        .arg(received).arg(lastRecordMsecs).arg(recordsPerSec, 0, 'f', 0)
+        .arg(percentile(50)).arg(percentile(90)).arg(percentile(99)).arg(percentile(100))
+        .arg(stallMsecs).arg(maxGapMsecs);
+    qInfo().noquote() << QStringLiteral("Memory growth KiB: browser %1 renderer %2")
+        .arg((browserAfter.isValid && browserBefore.isValid)
+             ? QString::number((browserAfter.rssBytes - browserBefore.rssBytes) / 1024)
+             : QStringLiteral("n/a"),
+             (rendererAfter.isValid && rendererBefore.isValid)
+             ? QString::number((rendererAfter.rssBytes - rendererBefore.rssBytes) / 1024)
+             : QStringLiteral("n/a"));
+    QTest::setBenchmarkResult(recordsPerSec, QTest::Events);
+}
+
+int main(int argc, char *argv[])
+{
+    // Render offscreen, unless told otherwise. This must be done before QApplication is
+    // initialised.
+    if ((!qEnvironmentVariableIsSet("QT_QPA_PLATFORM")) &&
+        (!qputenv("QT_QPA_PLATFORM", "offscreen"))) {
+        qWarning() << "Failed to set QT_QPA_PLATFORM to offscreen";
+    }
+    QApplication app(argc, argv);
+    TestMutationStorm test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "tst_mutationstorm.moc"
@@ -0,0 +1,11 @@
+include(../test.pri)
+
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/synchistory.h \
+
+SOURCES += \
+  ../../src/synchistory.cpp \
@@ -0,0 +1,217 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <QDateTime>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "synchistory.h"
+
+class TestSyncHistory : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void roundTrip();
+    void missing();
+    void disabled();
+    void stop();
+    void tornLine();
+    void longLine();
+    void corruptLine();
+
+private:
+    QTemporaryDir dir;
+    QString fileName;
+
+    static SyncHistory::Entry entry(const int day, const float weight);
+    bool appendRaw(const QByteArray &bytes) const;
+    QList<SyncHistory::Entry> entries(qint64 * const count = Q_NULLPTR) const;
+
+};
+
+void TestSyncHistory::init()
+{
+    QVERIFY(dir.isValid());
+    fileName = dir.filePath(QStringLiteral("%1.jsonl")
+                            .arg(QString::fromLatin1(QTest::currentTestFunction())));
+}
+
+/*!
+ * Entries are read back oldest first, with their details intact.
+ */
+void TestSyncHistory::roundTrip()
+{
+    SyncHistory history(fileName);
+    SyncHistory::Entry first = entry(1, 75.1f);
+    first.measurement.bodyFat = 20.5f;
+    first.written = 74.87;
+    QVERIFY(history.append(first));
+    QVERIFY(history.append(entry(2, 75.2f)));
+
+    qint64 count;
+    const QList<SyncHistory::Entry> read = entries(&count);
+    QCOMPARE(count, Q_INT64_C(2));
+    QCOMPARE(read.size(), 2);
+    QCOMPARE(read.at(0).time, first.time);
+    QCOMPARE(read.at(0).account, first.account);
+    QCOMPARE(read.at(0).measurement.date, first.measurement.date);
+    QCOMPARE(read.at(0).measurement.weight, 75.1f);
+    QCOMPARE(read.at(0).measurement.bodyFat, 20.5f);
+    QCOMPARE(read.at(0).source, first.source);
+    QCOMPARE(read.at(0).status, first.status);
+    QCOMPARE(read.at(0).written, 74.87);
+    QCOMPARE(read.at(1).measurement.weight, 75.2f);
+    QCOMPARE(read.at(1).measurement.bodyFat, 0.0f);
+    QCOMPARE(read.at(1).written, 0.0);
+}
+
+/*!
+ * A history that has not been recorded yet is empty, not an error.
+ */
+void TestSyncHistory::missing()
+{
+    QCOMPARE(SyncHistory(fileName).read([](const SyncHistory::Entry &) { return true; }),
+             Q_INT64_C(0));
+}
+
+/*!
+ * Without a file name, nothing is recorded.
+ */
+void TestSyncHistory::disabled()
+{
+    SyncHistory history((QString()));
+    QVERIFY(history.append(entry(1, 75.1f)));
+    QCOMPARE(history.read([](const SyncHistory::Entry &) { return true; }), Q_INT64_C(0));
+}
+
+/*!
+ * Reading stops as soon as the visitor asks it to.
+ */
+void TestSyncHistory::stop()
+{
+    SyncHistory history(fileName);
+    for (int day = 1; day <= 3; ++day) {
+        QVERIFY(history.append(entry(day, 75.0f)));
+    }
+    int visited = 0;
+    QCOMPARE(history.read([&visited](const SyncHistory::Entry &) { return (++visited < 2); }),
+             Q_INT64_C(2));
+    QCOMPARE(visited, 2);
+}
+
+/*!
+ * A final line torn by a crash mid-write (or still being appended) is skipped, and does not
+ * corrupt the next line appended.
+ */
+void TestSyncHistory::tornLine()
+{
+    SyncHistory history(fileName);
+    QVERIFY(history.append(entry(1, 75.1f)));
+    QVERIFY(appendRaw("{\"time\":\"2019-01-02T07:01:00.000Z\",\"account\":\"ali"));
+    QCOMPARE(entries().size(), 1);
+
+    QVERIFY(history.append(entry(3, 75.3f)));
+    const QList<SyncHistory::Entry> read = entries();
+    QCOMPARE(read.size(), 2);
+    QCOMPARE(read.at(1).measurement.weight, 75.3f);
+}
+
+/*!
+ * Lines too long to be genuine are skipped whole, without affecting the lines around them, even
+ * when the over-long line is the last.
+ */
+void TestSyncHistory::longLine()
+{
+    SyncHistory history(fileName);
+    QVERIFY(history.append(entry(1, 75.1f)));
+    QVERIFY(appendRaw("{\"account\":\"" + QByteArray(10000, 'x') + "\"}\n"));
+    QVERIFY(history.append(entry(2, 75.2f)));
+    QVERIFY(appendRaw(QByteArray(5000, 'y') + '\n'));
+
+    qint64 count;
+    const QList<SyncHistory::Entry> read = entries(&count);
+    QCOMPARE(count, Q_INT64_C(2));
+    QCOMPARE(read.size(), 2);
+    QCOMPARE(read.at(0).measurement.weight, 75.1f);
+    QCOMPARE(read.at(1).measurement.weight, 75.2f);
+}
+
+/*!
+ * Corrupt lines anywhere in the history are skipped, without affecting the lines around them.
+ */
+void TestSyncHistory::corruptLine()
+{
+    SyncHistory history(fileName);
+    QVERIFY(history.append(entry(1, 75.1f)));
+    QVERIFY(appendRaw("not json\n\n[1,2,3]\n"));
+    QVERIFY(history.append(entry(2, 75.2f)));
+    QCOMPARE(entries().size(), 2);
+}
+
+// Private Methods
+
+/*!
+ * Returns a synced entry for alice's measurement on the given \a day (of 2019), of \a weight.
+ */
+SyncHistory::Entry TestSyncHistory::entry(const int day, const float weight)
+{
+    SyncHistory::Entry entry;
+    entry.measurement.date = QDateTime(QDate(2019, 1, 1).addDays(day - 1), QTime(7, 0), Qt::UTC);
+    entry.measurement.weight = weight;
+    entry.time = entry.measurement.date.addSecs(60);
+    entry.account = QStringLiteral("alice");
+    entry.source = QStringLiteral("fitbit");
+    entry.status = QStringLiteral("synced");
+    return entry;
+}
+
+/*!
+ * Appends \a bytes to the history file as is, as a crashed or misbehaving writer might.
+ */
+bool TestSyncHistory::appendRaw(const QByteArray &bytes) const
+{
+    QFile file(fileName);
+    return ((file.open(QIODevice::WriteOnly|QIODevice::Append)) &&
+            (file.write(bytes) == bytes.size()));
+}
+
+/*!
+ * Returns all of the entries in the history, and sets \a count (if not null) to the number that
+ * SyncHistory::read() reported.
+ */
+QList<SyncHistory::Entry> TestSyncHistory::entries(qint64 * const count) const
+{
+    QList<SyncHistory::Entry> list;
+    const qint64 visited = SyncHistory(fileName).read([&list](const SyncHistory::Entry &entry) {
+        list.append(entry);
+        return true;
+    });
+    if (count != Q_NULLPTR) {
+        *count = visited;
+    }
+    return list;
+}
+
+QTEST_APPLESS_MAIN(TestSyncHistory)
+
+#include "tst_synchistory.moc"
@@ -1,3 +1,13 @@
 TEMPLATE = subdirs
 
 SUBDIRS += \
+  exportwriter \
+  synchistory \
+  trendengine \
+  webarchive \
+  webhookreceiver \
+  writejournal \
+
+# The mutation storm stress test drives a real web engine for several seconds per data row, so it
+# is too slow (and timing sensitive) for every check run. Build it with CONFIG+=stress instead.
+stress:SUBDIRS += mutationstorm
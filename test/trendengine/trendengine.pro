@@ -0,0 +1,13 @@
+include(../test.pri)
+
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/runsummary.h \
+  ../../src/trendengine.h \
+
+SOURCES += \
+  ../../src/runsummary.cpp \
+  ../../src/trendengine.cpp \
@@ -0,0 +1,210 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDateTime>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QVector>
+
+#include <cmath>
+#include <random>
+
+#include "trendengine.h"
+
+Q_DECLARE_METATYPE(TrendEngine::Verdict)
+
+class TestTrendEngine : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void update_data();
+    void update();
+    void duplicateDate();
+    void threshold();
+    void batch_data();
+    void batch();
+    void persistence();
+
+};
+
+void TestTrendEngine::update_data()
+{
+    QTest::addColumn<QVector<double>>("masses");
+    QTest::addColumn<TrendEngine::Verdict>("lastVerdict");
+    QTest::addColumn<double>("level");
+
+    QTest::newRow("first") << QVector<double>{ 75.0 } << TrendEngine::Reset << 75.0;
+    QTest::newRow("smoothed") << QVector<double>{ 75.0, 76.0 } << TrendEngine::Accepted << 75.25;
+    QTest::newRow("outlier") << QVector<double>{ 75.0, 75.2, 74.9, 90.0 }
+                             << TrendEngine::Rejected << 75.0125;
+    QTest::newRow("recovered") << QVector<double>{ 75.0, 75.2, 74.9, 90.0, 75.0 }
+                               << TrendEngine::Accepted << 75.0094;
+    QTest::newRow("implausible") << QVector<double>{ 75.0, 5.0 } << TrendEngine::Rejected << 75.0;
+    QTest::newRow("implausible-first") << QVector<double>{ 5.0 } << TrendEngine::Rejected << 0.0;
+    QTest::newRow("NaN") << QVector<double>{ 75.0, qQNaN() } << TrendEngine::Unchanged << 75.0;
+    QTest::newRow("step-change") << QVector<double>{ 75.0, 75.2, 80.0, 80.2, 79.9 }
+                                 << TrendEngine::Reset << 79.9;
+}
+
+/*!
+ * Feeds a series of daily \a masses to a single trend, checking the verdict on the last one, and
+ * the resulting trend level.
+ */
+void TestTrendEngine::update()
+{
+    QFETCH(QVector<double>, masses);
+    QFETCH(TrendEngine::Verdict, lastVerdict);
+    QFETCH(double, level);
+
+    TrendEngine trend;
+    const int index = trend.append(QStringLiteral("alice"));
+    const QDateTime start(QDate(2019, 1, 1), QTime(7, 0), Qt::UTC);
+    TrendEngine::Verdict verdict = TrendEngine::Unchanged;
+    for (int day = 0; day < masses.size(); ++day) {
+        verdict = trend.update(index, start.addDays(day), masses.at(day));
+    }
+    QCOMPARE(TrendEngine::toString(verdict), TrendEngine::toString(lastVerdict));
+    QVERIFY2(std::fabs(trend.level(index) - level) < 0.001,
+             qPrintable(QString::number(trend.level(index))));
+}
+
+void TestTrendEngine::duplicateDate()
+{
+    TrendEngine trend;
+    const int index = trend.append(QStringLiteral("alice"));
+    const QDateTime date(QDate(2019, 1, 1), QTime(7, 0), Qt::UTC);
+    QCOMPARE(trend.update(index, date, 75.0), TrendEngine::Reset);
+    QCOMPARE(trend.update(index, date, 90.0), TrendEngine::Unchanged);
+    QCOMPARE(trend.update(index, date.addSecs(-60), 76.0), TrendEngine::Unchanged);
+    QCOMPARE(trend.count(index), 1);
+    QCOMPARE(trend.rejections(index), 0);
+    QCOMPARE(trend.level(index), 75.0);
+}
+
+/*!
+ * The significance threshold should shrink as a steady scale's noise estimate settles, but never
+ * below that implied by the noise floor.
+ */
+void TestTrendEngine::threshold()
+{
+    TrendEngine::Parameters parameters;
+    TrendEngine trend(parameters);
+    const int index = trend.append(QStringLiteral("alice"));
+    const QDateTime start(QDate(2019, 1, 1), QTime(7, 0), Qt::UTC);
+    trend.update(index, start, 75.0);
+    const double initial = trend.threshold(index);
+    for (int day = 1; day < 30; ++day) {
+        trend.update(index, start.addDays(day), 75.0 + ((day % 2) ? 0.05 : -0.05));
+    }
+    const double floor = parameters.significance * parameters.minNoise *
+        std::sqrt(parameters.alpha / (2.0 - parameters.alpha));
+    QVERIFY(trend.threshold(index) < initial);
+    QVERIFY(trend.threshold(index) >= floor);
+    QCOMPARE(trend.rejections(index), 0);
+}
+
+void TestTrendEngine::batch_data()
+{
+    QTest::addColumn<int>("accounts");
+    QTest::newRow("1") << 1;
+    QTest::newRow("1000") << 1000;
+    QTest::newRow("10000") << 10000;
+}
+
+/*!
+ * Updating many trends in one batch should match updating them one at a time, and (since the batch
+ * kernel is vectorizable) be fast.
+ */
+void TestTrendEngine::batch()
+{
+    QFETCH(int, accounts);
+
+    TrendEngine batched, single;
+    for (int index = 0; index < accounts; ++index) {
+        batched.append(QString::number(index));
+        single.append(QString::number(index));
+    }
+
+    // Simulate a month of daily measurements (with occasional outliers, and missed days).
+    std::mt19937 generator(accounts);
+    std::normal_distribution<double> noise(0.0, 0.4);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    const QDateTime start(QDate(2019, 1, 1), QTime(7, 0), Qt::UTC);
+    QVector<qint64> dates(accounts);
+    QVector<double> masses(accounts);
+    QVector<TrendEngine::Verdict> verdicts;
+    for (int day = 0; day < 30; ++day) {
+        const QDateTime date = start.addDays(day);
+        for (int index = 0; index < accounts; ++index) {
+            const double roll = chance(generator);
+            dates[index] = (roll < 0.1) ? 0 : date.toMSecsSinceEpoch();
+            masses[index] = 60.0 + (index % 40) + noise(generator) + ((roll > 0.98) ? 15.0 : 0.0);
+        }
+        batched.update(dates, masses, verdicts);
+        for (int index = 0; index < accounts; ++index) {
+            const TrendEngine::Verdict verdict = single.update(index,
+                dates.at(index) ? QDateTime::fromMSecsSinceEpoch(dates.at(index), Qt::UTC)
+                                : QDateTime(), masses.at(index));
+            QCOMPARE(verdicts.at(index), verdict);
+            QCOMPARE(batched.level(index), single.level(index));
+        }
+    }
+
+    QBENCHMARK {
+        dates.fill(start.addDays(30).toMSecsSinceEpoch());
+        batched.update(dates, masses, verdicts);
+    }
+}
+
+void TestTrendEngine::persistence()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString fileName = dir.filePath(QStringLiteral("state.ini"));
+
+    TrendEngine saved;
+    saved.append(QStringLiteral("alice"));
+    saved.append(QStringLiteral("bob"));
+    const QDateTime start(QDate(2019, 1, 1), QTime(7, 0), Qt::UTC);
+    saved.update(0, start, 75.0);
+    saved.update(0, start.addDays(1), 75.4);
+    saved.update(0, start.addDays(2), 95.0);
+    saved.update(1, start, 60.0);
+    saved.save(fileName);
+
+    TrendEngine loaded;
+    loaded.append(QStringLiteral("bob"));
+    loaded.append(QStringLiteral("alice"));
+    loaded.append(QStringLiteral("carol"));
+    loaded.load(fileName);
+    QCOMPARE(loaded.level(1), saved.level(0));
+    QCOMPARE(loaded.noise(1), saved.noise(0));
+    QCOMPARE(loaded.count(1), saved.count(0));
+    QCOMPARE(loaded.rejections(1), 1);
+    QCOMPARE(loaded.level(0), 60.0);
+    QCOMPARE(loaded.count(2), 0);
+
+    // The last measurement's date is persisted too, so it isn't counted again.
+    QCOMPARE(loaded.update(1, start.addDays(2), 95.0), TrendEngine::Unchanged);
+}
+
+QTEST_APPLESS_MAIN(TestTrendEngine)
+
+#include "tst_trendengine.moc"
@@ -0,0 +1,257 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "webarchive.h"
+
+class TestWebArchive : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void roundTrip();
+    void requestBody();
+    void takeRequestBody_data();
+    void takeRequestBody();
+    void redirect();
+    void reopen();
+    void legacyEntry();
+    void missingIndex();
+
+private:
+    QTemporaryDir dir;
+    QString dirName;
+
+    static WebArchive::Response response(const QByteArray &body);
+
+};
+
+void TestWebArchive::init()
+{
+    QVERIFY(dir.isValid());
+    dirName = dir.filePath(QString::fromLatin1(QTest::currentTestFunction()));
+}
+
+/*!
+ * A recorded response is loaded back with its status, MIME type, headers and body, for the same
+ * method and URL only. The archive scheme and original URLs are interchangeable.
+ */
+void TestWebArchive::roundTrip()
+{
+    WebArchive archive(dirName, WebArchive::Mode::Record);
+    QVERIFY(archive.open());
+    const QUrl url(QStringLiteral("https://example.com/page?q=1"));
+    WebArchive::Response stored = response("<html>page</html>");
+    stored.status = 404;
+    QVERIFY(archive.store("GET", url, QByteArray(), stored));
+
+    WebArchive::Response loaded;
+    QVERIFY(archive.load("GET", WebArchive::archiveUrl(url), QByteArray(), loaded));
+    QCOMPARE(loaded.status, 404);
+    QCOMPARE(loaded.mimeType, stored.mimeType);
+    QVERIFY(!loaded.location.isValid());
+    QCOMPARE(loaded.headers, stored.headers);
+    QCOMPARE(loaded.body, stored.body);
+
+    QVERIFY(!archive.load("POST", url, QByteArray(), loaded));
+    QVERIFY(!archive.load("GET", QUrl(QStringLiteral("https://example.com/page?q=2")),
+                          QByteArray(), loaded));
+}
+
+/*!
+ * Requests with bodies are keyed on their bodies too, while those without keep the same keys.
+ */
+void TestWebArchive::requestBody()
+{
+    WebArchive archive(dirName, WebArchive::Mode::Record);
+    QVERIFY(archive.open());
+    const QUrl url(QStringLiteral("https://example.com/login"));
+    QVERIFY(archive.store("POST", url, "user=alice", response("alice")));
+    QVERIFY(archive.store("POST", url, "user=bob", response("bob")));
+    QVERIFY(archive.store("POST", url, QByteArray(), response("nobody")));
+
+    WebArchive::Response loaded;
+    QVERIFY(archive.load("POST", url, "user=alice", loaded));
+    QCOMPARE(loaded.body, QByteArray("alice"));
+    QVERIFY(archive.load("POST", url, "user=bob", loaded));
+    QCOMPARE(loaded.body, QByteArray("bob"));
+    QVERIFY(archive.load("POST", url, QByteArray(), loaded));
+    QCOMPARE(loaded.body, QByteArray("nobody"));
+    QVERIFY(!archive.load("POST", url, "user=carol", loaded));
+    QVERIFY(!archive.load("GET", url, "user=alice", loaded));
+}
+
+void TestWebArchive::takeRequestBody_data()
+{
+    QTest::addColumn<QUrl>("url");
+    QTest::addColumn<QUrl>("stripped");
+    QTest::addColumn<QByteArray>("method");
+    QTest::addColumn<QByteArray>("body");
+    QTest::addColumn<QByteArray>("contentType");
+
+    const QUrl plain(QStringLiteral("https://example.com/path?a=1&b=%2F+x"));
+    QTest::newRow("none") << plain << plain << QByteArray("PUT") << QByteArray() << QByteArray();
+    QTest::newRow("body") << QUrl(QStringLiteral(
+        "https://example.com/path?a=1&b=%2F+x&float-archive-body=dXNlcj1hbGljZQ%3D%3D"
+        "&float-archive-type=application%2Fx-www-form-urlencoded%3Bcharset%3DUTF-8"))
+        << plain << QByteArray("PUT") << QByteArray("user=alice")
+        << QByteArray("application/x-www-form-urlencoded;charset=UTF-8");
+    QTest::newRow("form") << QUrl(QStringLiteral(
+        "https://example.com/login?float-archive-body=dXNlcj1hbGljZQ%3D%3D"
+        "&float-archive-method=post"))
+        << QUrl(QStringLiteral("https://example.com/login")) << QByteArray("POST")
+        << QByteArray("user=alice") << QByteArray();
+    QTest::newRow("empty") << QUrl(QStringLiteral("https://example.com/?float-archive-body="))
+        << QUrl(QStringLiteral("https://example.com/")) << QByteArray("PUT") << QByteArray()
+        << QByteArray();
+}
+
+/*!
+ * The query items carrying a request's body, method and content type are taken from its URL,
+ * leaving the rest of the URL exactly as it was.
+ */
+void TestWebArchive::takeRequestBody()
+{
+    QFETCH(QUrl, url);
+    QFETCH(QUrl, stripped);
+    QFETCH(QByteArray, method);
+    QFETCH(QByteArray, body);
+    QFETCH(QByteArray, contentType);
+
+    QCOMPARE(WebArchive::hasRequestBody(url), url != stripped);
+    QByteArray actualMethod("PUT"), actualBody, actualContentType;
+    const QUrl actual =
+        WebArchive::takeRequestBody(url, actualMethod, actualBody, actualContentType);
+    QCOMPARE(actual.toEncoded(), stripped.toEncoded());
+    QCOMPARE(actualMethod, method);
+    QCOMPARE(actualBody, body);
+    QCOMPARE(actualContentType, contentType);
+}
+
+/*!
+ * Redirects are recorded with their location, and an empty body.
+ */
+void TestWebArchive::redirect()
+{
+    WebArchive archive(dirName, WebArchive::Mode::Record);
+    QVERIFY(archive.open());
+    const QUrl url(QStringLiteral("https://example.com/login"));
+    WebArchive::Response stored = response(QByteArray());
+    stored.status = 302;
+    stored.location = QUrl(QStringLiteral("https://example.com/home"));
+    QVERIFY(archive.store("GET", url, QByteArray(), stored));
+
+    WebArchive::Response loaded;
+    QVERIFY(archive.load("GET", url, QByteArray(), loaded));
+    QCOMPARE(loaded.status, 302);
+    QCOMPARE(loaded.location, stored.location);
+    QVERIFY(loaded.body.isEmpty());
+}
+
+/*!
+ * Recordings are replayed by a later archive on the same directory, with re-recorded responses
+ * replacing earlier ones.
+ */
+void TestWebArchive::reopen()
+{
+    const QUrl url(QStringLiteral("https://example.com/"));
+    {
+        WebArchive archive(dirName, WebArchive::Mode::Record);
+        QVERIFY(archive.open());
+        QVERIFY(archive.store("GET", url, QByteArray(), response("first")));
+        QVERIFY(archive.store("GET", url, QByteArray(), response("second")));
+    }
+
+    WebArchive archive(dirName, WebArchive::Mode::Replay);
+    QVERIFY(archive.open());
+    WebArchive::Response loaded;
+    QVERIFY(archive.load("GET", url, QByteArray(), loaded));
+    QCOMPARE(loaded.body, QByteArray("second"));
+    QCOMPARE(loaded.headers, response("second").headers);
+}
+
+/*!
+ * Entries recorded before statuses and headers were archived replay as plain 200 (OK) responses.
+ */
+void TestWebArchive::legacyEntry()
+{
+    const QUrl url(QStringLiteral("https://example.com/"));
+    {
+        WebArchive archive(dirName, WebArchive::Mode::Record);
+        QVERIFY(archive.open());
+        QVERIFY(archive.store("GET", url, QByteArray(), response("body")));
+    }
+
+    // Strip the index entry back to the fields the original archive format had.
+    QFile index(dirName + QStringLiteral("/index.jsonl"));
+    QVERIFY(index.open(QIODevice::ReadOnly));
+    QJsonObject entry = QJsonDocument::fromJson(index.readAll()).object();
+    index.close();
+    QVERIFY(entry.contains(QStringLiteral("status")));
+    entry.remove(QStringLiteral("status"));
+    entry.remove(QStringLiteral("headers"));
+    QVERIFY(index.open(QIODevice::WriteOnly|QIODevice::Truncate));
+    QVERIFY(index.write(QJsonDocument(entry).toJson(QJsonDocument::Compact) + '\n') > 0);
+    index.close();
+
+    WebArchive archive(dirName, WebArchive::Mode::Replay);
+    QVERIFY(archive.open());
+    WebArchive::Response loaded;
+    QVERIFY(archive.load("GET", url, QByteArray(), loaded));
+    QCOMPARE(loaded.status, 200);
+    QVERIFY(loaded.headers.isEmpty());
+    QCOMPARE(loaded.body, QByteArray("body"));
+}
+
+/*!
+ * Replaying requires an existing recording, but recording may start a new one.
+ */
+void TestWebArchive::missingIndex()
+{
+    QVERIFY(!WebArchive(dirName, WebArchive::Mode::Replay).open());
+    QVERIFY(WebArchive(dirName, WebArchive::Mode::Record).open());
+    QVERIFY(QFile::exists(dirName));
+}
+
+// Private Methods
+
+/*!
+ * Returns a 200 (OK) HTML response with \a body.
+ */
+WebArchive::Response TestWebArchive::response(const QByteArray &body)
+{
+    WebArchive::Response response;
+    response.mimeType = "text/html";
+    response.headers.append(qMakePair(QByteArray("Content-Type"),
+                                      QByteArray("text/html; charset=utf-8")));
+    response.headers.append(qMakePair(QByteArray("Set-Cookie"), QByteArray("session=") + body));
+    response.body = body;
+    return response;
+}
+
+QTEST_APPLESS_MAIN(TestWebArchive)
+
+#include "tst_webarchive.moc"
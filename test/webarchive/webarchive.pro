@@ -0,0 +1,13 @@
+include(../test.pri)
+
+# The archive registers its URL scheme with the web engine, though nothing here loads any pages.
+QT += webenginecore
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/webarchive.h \
+
+SOURCES += \
+  ../../src/webarchive.cpp \
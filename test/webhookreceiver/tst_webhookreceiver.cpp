@@ -0,0 +1,272 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDebug>
+#include <QHostAddress>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QTest>
+
+#include "webhookreceiver.h"
+
+#define CLIENT_SECRET QByteArrayLiteral("secret")
+#define VERIFICATION_CODE QStringLiteral("c0de")
+
+class TestWebhookReceiver : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void signature();
+    void verify_data();
+    void verify();
+    void malformed_data();
+    void malformed();
+    void notify_data();
+    void notify();
+    void debounce();
+    void fragmented();
+
+private:
+    WebhookReceiver * receiver;
+
+    int send(const QList<QByteArray> &chunks);
+    static QByteArray post(const QByteArray &body, const QByteArray &signature);
+
+};
+
+void TestWebhookReceiver::init()
+{
+    Account alice;
+    alice.name = QStringLiteral("/path/to/alice.ini");
+    alice.fitbitUserId = QStringLiteral("ABC123");
+    Account bob;
+    bob.name = QStringLiteral("bob.ini");
+    receiver = new WebhookReceiver({ alice, bob }, CLIENT_SECRET, VERIFICATION_CODE, this);
+    receiver->setDebounce(50);
+    QVERIFY(receiver->listen(0));
+    QVERIFY(receiver->serverPort() > 0);
+}
+
+void TestWebhookReceiver::cleanup()
+{
+    delete receiver;
+    receiver = Q_NULLPTR;
+}
+
+void TestWebhookReceiver::signature()
+{
+    // Base64 encoded HMAC-SHA1 of "[]", keyed by "secret&", as computed independently.
+    QCOMPARE(WebhookReceiver::signature(QByteArrayLiteral("[]"), CLIENT_SECRET),
+             QByteArrayLiteral("vy40yZ+Xm7kAVBOfufPWvl40opU="));
+    QVERIFY(WebhookReceiver::signature(QByteArrayLiteral("[ ]"), CLIENT_SECRET) !=
+            QByteArrayLiteral("vy40yZ+Xm7kAVBOfufPWvl40opU="));
+}
+
+void TestWebhookReceiver::verify_data()
+{
+    QTest::addColumn<QByteArray>("query");
+    QTest::addColumn<int>("status");
+
+    QTest::newRow("correct") << QByteArray("?verify=c0de") << 204;
+    QTest::newRow("incorrect") << QByteArray("?verify=wrong") << 404;
+    QTest::newRow("empty") << QByteArray("?verify=") << 404;
+    QTest::newRow("missing") << QByteArray() << 404;
+}
+
+/*!
+ * Fitbit's subscriber verification requests get 204 for the correct code, and 404 otherwise.
+ */
+void TestWebhookReceiver::verify()
+{
+    QFETCH(QByteArray, query);
+    QFETCH(int, status);
+    QCOMPARE(send({ "GET /" + query + " HTTP/1.1\r\nHost: localhost\r\n\r\n" }), status);
+}
+
+void TestWebhookReceiver::malformed_data()
+{
+    QTest::addColumn<QByteArray>("request");
+    QTest::addColumn<int>("status");
+
+    QTest::newRow("method") << QByteArray("PUT / HTTP/1.1\r\n\r\n") << 405;
+    QTest::newRow("request-line") << QByteArray("GET /\r\n\r\n") << 400;
+    QTest::newRow("negative-length") << QByteArray("POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n")
+                                     << 400;
+    QTest::newRow("excessive-length")
+        << QByteArray("POST / HTTP/1.1\r\nContent-Length: 1000000\r\n\r\n") << 400;
+    QTest::newRow("oversized") << QByteArray("POST / HTTP/1.1\r\nX-Padding: ")
+                                  + QByteArray(70 * 1024, 'x') << 413;
+}
+
+/*!
+ * Malformed, oversized and unsupported requests are refused, without waiting for more data.
+ */
+void TestWebhookReceiver::malformed()
+{
+    QFETCH(QByteArray, request);
+    QFETCH(int, status);
+    QSignalSpy spy(receiver, &WebhookReceiver::syncRequested);
+    QCOMPARE(send({ request }), status);
+    QCOMPARE(spy.count(), 0);
+}
+
+void TestWebhookReceiver::notify_data()
+{
+    QTest::addColumn<QByteArray>("body");
+    QTest::addColumn<QByteArray>("signature");
+    QTest::addColumn<int>("status");
+    QTest::addColumn<QString>("account");
+
+    const QByteArray byOwner =
+        R"([{"collectionType":"body","date":"2019-09-19","ownerId":"ABC123","ownerType":"user",)"
+        R"("subscriptionId":"1"}])";
+    const QByteArray bySubscription =
+        R"([{"collectionType":"body","date":"2019-09-19","ownerId":"XYZ","ownerType":"user",)"
+        R"("subscriptionId":"bob"}])";
+    const QByteArray unknown =
+        R"([{"collectionType":"body","date":"2019-09-19","ownerId":"XYZ","ownerType":"user",)"
+        R"("subscriptionId":"carol"}])";
+    const QByteArray activities =
+        R"([{"collectionType":"activities","date":"2019-09-19","ownerId":"ABC123",)"
+        R"("ownerType":"user","subscriptionId":"1"}])";
+
+    QTest::newRow("owner") << byOwner << WebhookReceiver::signature(byOwner, CLIENT_SECRET)
+                           << 204 << QStringLiteral("/path/to/alice.ini");
+    QTest::newRow("subscription") << bySubscription
+                                  << WebhookReceiver::signature(bySubscription, CLIENT_SECRET)
+                                  << 204 << QStringLiteral("bob.ini");
+    QTest::newRow("unknown") << unknown << WebhookReceiver::signature(unknown, CLIENT_SECRET)
+                             << 204 << QString();
+    QTest::newRow("collection") << activities
+                                << WebhookReceiver::signature(activities, CLIENT_SECRET)
+                                << 204 << QString();
+    QTest::newRow("not-json") << QByteArray("{") << WebhookReceiver::signature("{", CLIENT_SECRET)
+                              << 204 << QString();
+    QTest::newRow("bad-signature") << byOwner << WebhookReceiver::signature(byOwner, "wrong")
+                                   << 404 << QString();
+    QTest::newRow("truncated-signature")
+        << byOwner << WebhookReceiver::signature(byOwner, CLIENT_SECRET).left(10) << 404
+        << QString();
+    QTest::newRow("no-signature") << byOwner << QByteArray() << 404 << QString();
+}
+
+/*!
+ * Notifications are only acted on if correctly signed, and then only for weight changes of known
+ * accounts, in which case a fresh sync of the \a account is requested.
+ */
+void TestWebhookReceiver::notify()
+{
+    QFETCH(QByteArray, body);
+    QFETCH(QByteArray, signature);
+    QFETCH(int, status);
+    QFETCH(QString, account);
+
+    QSignalSpy spy(receiver, &WebhookReceiver::syncRequested);
+    QCOMPARE(send({ post(body, signature) }), status);
+    if (account.isEmpty()) {
+        QTest::qWait(200);
+        QCOMPARE(spy.count(), 0);
+        return;
+    }
+    QTRY_COMPARE(spy.count(), 1);
+    QCOMPARE(spy.first().at(0).toString(), account);
+    QCOMPARE(spy.first().at(1).toBool(), true);
+}
+
+/*!
+ * A burst of notifications for an account results in a single sync request.
+ */
+void TestWebhookReceiver::debounce()
+{
+    const QByteArray body =
+        R"([{"collectionType":"body","date":"2019-09-19","ownerId":"ABC123","ownerType":"user",)"
+        R"("subscriptionId":"1"}])";
+    const QByteArray request = post(body, WebhookReceiver::signature(body, CLIENT_SECRET));
+    QSignalSpy spy(receiver, &WebhookReceiver::syncRequested);
+    for (int count = 0; count < 3; ++count) {
+        QCOMPARE(send({ request }), 204);
+    }
+    QTRY_COMPARE(spy.count(), 1);
+    QTest::qWait(200);
+    QCOMPARE(spy.count(), 1);
+}
+
+/*!
+ * Requests arriving in pieces (split within the headers, and the body) are reassembled.
+ */
+void TestWebhookReceiver::fragmented()
+{
+    const QByteArray body =
+        R"([{"collectionType":"body","date":"2019-09-19","ownerId":"ABC123","ownerType":"user",)"
+        R"("subscriptionId":"1"}])";
+    const QByteArray request = post(body, WebhookReceiver::signature(body, CLIENT_SECRET));
+    const int headerEnd = request.indexOf("\r\n\r\n");
+    QSignalSpy spy(receiver, &WebhookReceiver::syncRequested);
+    QCOMPARE(send({ request.left(10), request.mid(10, headerEnd - 8),
+                    request.mid(headerEnd + 2, 20), request.mid(headerEnd + 22) }), 204);
+    QTRY_COMPARE(spy.count(), 1);
+}
+
+// Private Methods
+
+/*!
+ * Sends the request \a chunks to the receiver, one at a time (letting each arrive before sending
+ * the next), and returns the response's HTTP status code, or -1 if there was no response.
+ */
+int TestWebhookReceiver::send(const QList<QByteArray> &chunks)
+{
+    QTcpSocket socket;
+    QSignalSpy connected(&socket, &QTcpSocket::connected);
+    QSignalSpy disconnected(&socket, &QTcpSocket::disconnected);
+    socket.connectToHost(QHostAddress::LocalHost, receiver->serverPort());
+    if ((connected.isEmpty()) && (!connected.wait())) {
+        qWarning() << "Failed to connect" << socket.errorString();
+        return -1;
+    }
+    for (const QByteArray &chunk: chunks) {
+        socket.write(chunk);
+        socket.flush();
+        QTest::qWait(20);
+    }
+    if ((disconnected.isEmpty()) && (!disconnected.wait())) {
+        qWarning() << "No response" << socket.errorString();
+        return -1;
+    }
+    const QList<QByteArray> statusLine = socket.readLine().trimmed().split(' ');
+    return (statusLine.size() >= 2) ? statusLine.at(1).toInt() : -1;
+}
+
+/*!
+ * Returns a notification POST request for \a body, with the \a signature header (if not empty).
+ */
+QByteArray TestWebhookReceiver::post(const QByteArray &body, const QByteArray &signature)
+{
+    QByteArray request = "POST / HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n";
+    if (!signature.isEmpty()) {
+        request += "X-Fitbit-Signature: " + signature + "\r\n";
+    }
+    return request + "Content-Length: " + QByteArray::number(body.size()) + "\r\n\r\n" + body;
+}
+
+QTEST_GUILESS_MAIN(TestWebhookReceiver)
+
+#include "tst_webhookreceiver.moc"
@@ -0,0 +1,14 @@
+include(../test.pri)
+
+QT += network
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/account.h \
+  ../../src/webhookreceiver.h \
+
+SOURCES += \
+  ../../src/account.cpp \
+  ../../src/webhookreceiver.cpp \
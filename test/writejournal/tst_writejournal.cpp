@@ -0,0 +1,222 @@
+/*
+    Copyright 2019 Paul Colby <git@colby.id.au>
+
+    This file is part of Float.
+
+    Float is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Float is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Float.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include <QDateTime>
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "writejournal.h"
+
+class TestWriteJournal : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void pending();
+    void replace();
+    void written();
+    void memory();
+    void tornLine();
+    void corruptLine();
+    void compaction();
+
+private:
+    QTemporaryDir dir;
+    QString fileName;
+
+    static WriteJournal::Entry entry(const QString &account, const int day, const double mass);
+    int lineCount() const;
+
+};
+
+void TestWriteJournal::init()
+{
+    QVERIFY(dir.isValid());
+    fileName = dir.filePath(QStringLiteral("%1.jsonl")
+                            .arg(QString::fromLatin1(QTest::currentTestFunction())));
+}
+
+/*!
+ * Pending writes are returned oldest measurement first, regardless of the order journaled, and
+ * only for the requested account.
+ */
+void TestWriteJournal::pending()
+{
+    WriteJournal journal(fileName);
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 2, 75.2)));
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 1, 75.1)));
+    QVERIFY(journal.append(entry(QStringLiteral("bob"), 1, 90.0)));
+
+    const QList<WriteJournal::Entry> pending = journal.pending(QStringLiteral("alice"));
+    QCOMPARE(pending.size(), 2);
+    QCOMPARE(pending.at(0).measurement, entry(QString(), 1, 0).measurement);
+    QCOMPARE(pending.at(0).mass, 75.1);
+    QCOMPARE(pending.at(1).mass, 75.2);
+    QCOMPARE(pending.at(1).queued, entry(QString(), 2, 0).queued);
+    QCOMPARE(journal.pending(QStringLiteral("bob")).size(), 1);
+    QVERIFY(journal.pending(QStringLiteral("carol")).isEmpty());
+
+    // A fresh journal on the same file (eg in the next process) sees the same pending writes.
+    QCOMPARE(WriteJournal(fileName).pending(QStringLiteral("alice")).size(), 2);
+}
+
+/*!
+ * Journaling the same measurement again replaces its pending entry.
+ */
+void TestWriteJournal::replace()
+{
+    WriteJournal journal(fileName);
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 1, 75.1)));
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 1, 75.3)));
+
+    const QList<WriteJournal::Entry> pending = journal.pending(QStringLiteral("alice"));
+    QCOMPARE(pending.size(), 1);
+    QCOMPARE(pending.first().mass, 75.3);
+}
+
+/*!
+ * Marking a measurement written resolves it, along with any older ones it superseded, but not newer
+ * ones, nor other accounts'.
+ */
+void TestWriteJournal::written()
+{
+    WriteJournal journal(fileName);
+    for (int day = 1; day <= 3; ++day) {
+        QVERIFY(journal.append(entry(QStringLiteral("alice"), day, 75.0 + day)));
+    }
+    QVERIFY(journal.append(entry(QStringLiteral("bob"), 1, 90.0)));
+    QVERIFY(journal.markWritten(QStringLiteral("alice"), entry(QString(), 2, 0).measurement));
+
+    const QList<WriteJournal::Entry> pending = journal.pending(QStringLiteral("alice"));
+    QCOMPARE(pending.size(), 1);
+    QCOMPARE(pending.first().measurement, entry(QString(), 3, 0).measurement);
+    QCOMPARE(journal.pending(QStringLiteral("bob")).size(), 1);
+
+    QVERIFY(journal.markWritten(QStringLiteral("alice"), entry(QString(), 3, 0).measurement));
+    QVERIFY(journal.pending(QStringLiteral("alice")).isEmpty());
+}
+
+/*!
+ * Without a file name, the journal works the same, but in memory only.
+ */
+void TestWriteJournal::memory()
+{
+    WriteJournal journal((QString()));
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 1, 75.1)));
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 2, 75.2)));
+    QVERIFY(journal.markWritten(QStringLiteral("alice"), entry(QString(), 1, 0).measurement));
+    QCOMPARE(journal.pending(QStringLiteral("alice")).size(), 1);
+    QVERIFY(!QFile::exists(fileName));
+}
+
+/*!
+ * A final line torn by a crash mid-write is skipped, and does not corrupt the next line appended.
+ */
+void TestWriteJournal::tornLine()
+{
+    {
+        WriteJournal journal(fileName);
+        QVERIFY(journal.append(entry(QStringLiteral("alice"), 1, 75.1)));
+    }
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly|QIODevice::Append));
+    QVERIFY(file.write("{\"op\":\"pending\",\"account\":\"alice\",\"meas") > 0);
+    file.close();
+
+    WriteJournal journal(fileName);
+    QCOMPARE(journal.pending(QStringLiteral("alice")).size(), 1);
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 2, 75.2)));
+    const QList<WriteJournal::Entry> pending = journal.pending(QStringLiteral("alice"));
+    QCOMPARE(pending.size(), 2);
+    QCOMPARE(pending.at(1).mass, 75.2);
+}
+
+/*!
+ * Corrupt lines anywhere in the journal are skipped, without affecting the lines around them.
+ */
+void TestWriteJournal::corruptLine()
+{
+    {
+        WriteJournal journal(fileName);
+        QVERIFY(journal.append(entry(QStringLiteral("alice"), 1, 75.1)));
+    }
+    QFile file(fileName);
+    QVERIFY(file.open(QIODevice::WriteOnly|QIODevice::Append));
+    QVERIFY(file.write("not json\n\n[1,2,3]\n") > 0);
+    file.close();
+
+    WriteJournal journal(fileName);
+    QVERIFY(journal.append(entry(QStringLiteral("alice"), 2, 75.2)));
+    QCOMPARE(journal.pending(QStringLiteral("alice")).size(), 2);
+}
+
+/*!
+ * Once the journal has grown long enough, it is rewritten with just its pending entries, which keep
+ * their details.
+ */
+void TestWriteJournal::compaction()
+{
+    WriteJournal journal(fileName);
+    const WriteJournal::Entry bob = entry(QStringLiteral("bob"), 1, 90.5);
+    QVERIFY(journal.append(bob));
+    for (int day = 1; day <= 200; ++day) {
+        QVERIFY(journal.append(entry(QStringLiteral("alice"), day, 75.0)));
+        QVERIFY(journal.markWritten(QStringLiteral("alice"), entry(QString(), day, 0).measurement));
+    }
+    QVERIFY(lineCount() < 200);
+
+    QVERIFY(journal.pending(QStringLiteral("alice")).isEmpty());
+    const QList<WriteJournal::Entry> pending = journal.pending(QStringLiteral("bob"));
+    QCOMPARE(pending.size(), 1);
+    QCOMPARE(pending.first().measurement, bob.measurement);
+    QCOMPARE(pending.first().mass, bob.mass);
+    QCOMPARE(pending.first().queued, bob.queued);
+}
+
+// Private Methods
+
+/*!
+ * Returns an entry for \a account's measurement on the given \a day (of 2019), of \a mass.
+ */
+WriteJournal::Entry TestWriteJournal::entry(const QString &account, const int day,
+                                            const double mass)
+{
+    const QDateTime date(QDate(2019, 1, 1).addDays(day - 1), QTime(7, 0), Qt::UTC);
+    WriteJournal::Entry entry;
+    entry.account = account;
+    entry.measurement = date.toString(Qt::ISODate);
+    entry.mass = mass;
+    entry.queued = date.addSecs(60);
+    return entry;
+}
+
+int TestWriteJournal::lineCount() const
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return -1;
+    }
+    return file.readAll().count('\n');
+}
+
+QTEST_APPLESS_MAIN(TestWriteJournal)
+
+#include "tst_writejournal.moc"
@@ -0,0 +1,11 @@
+include(../test.pri)
+
+CONFIG += C++11
+
+INCLUDEPATH += ../../src
+
+HEADERS += \
+  ../../src/writejournal.h \
+
+SOURCES += \
+  ../../src/writejournal.cpp \
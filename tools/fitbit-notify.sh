@@ -0,0 +1,35 @@
+#!/bin/bash
+#
+# Stands in for Fitbit, sending signed subscription notifications to a local float --webhook port.
+#
+# Usage: fitbit-notify.sh <port> <ownerId|subscriptionId> [count]
+#
+# Sends a subscriber verification request (if FITBIT_VERIFICATION_CODE is set), then count
+# (default 1) notifications for the given owner, signed with FITBIT_CLIENT_SECRET.
+
+set -o errexit -o noclobber -o nounset -o pipefail
+
+if [[ $# -lt 2 ]]; then
+  echo "Usage: ${0##*/} <port> <ownerId|subscriptionId> [count]" >&2
+  exit 2
+fi
+readonly PORT="$1" OWNER="$2" COUNT="${3:-1}"
+readonly URL="http://localhost:$PORT/"
+
+if [[ -n "${FITBIT_VERIFICATION_CODE:-}" ]]; then
+  echo -n 'Verify: '
+  curl --silent --output /dev/null --write-out '%{http_code}\n' \
+    "$URL?verify=$FITBIT_VERIFICATION_CODE"
+fi
+
+readonly BODY="[{\"collectionType\":\"body\",\"date\":\"$(date +%F)\",\"ownerId\":\"$OWNER\",\
+\"ownerType\":\"user\",\"subscriptionId\":\"$OWNER\"}]"
+readonly SIGNATURE=$(echo -n "$BODY" |
+  openssl dgst -sha1 -hmac "${FITBIT_CLIENT_SECRET:?is required}&" -binary | base64)
+
+for ((i = 1; i <= COUNT; i++)); do
+  echo -n "Notify $i: "
+  curl --silent --output /dev/null --write-out '%{http_code}\n' \
+    --header 'Content-Type: application/json' --header "X-Fitbit-Signature: $SIGNATURE" \
+    --data-binary "$BODY" "$URL"
+done